@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <vector>
+
+#include "activity.hpp"
+#include "map.hpp"
+#include "tile.hpp"
+#include "memory.hpp"
+
+void ActivityTracker::sleep(int pos, int wakeDay)
+{
+    if(pos >= this->wakeDays.size()) this->wakeDays.resize(pos+1, 0);
+    /* A sleeping tile can be given a new timer */
+    if(this->wakeDays[pos] == 0) this->changed.push_back(pos);
+    this->wakeDays[pos] = wakeDay;
+    if(wakeDay != never) this->timers.push(Timer(wakeDay, pos));
+
+    return;
+}
+
+void ActivityTracker::wake(int pos)
+{
+    if(!this->isAsleep(pos)) return;
+    this->wakeDays[pos] = 0;
+    this->changed.push_back(pos);
+
+    return;
+}
+
+void ActivityTracker::wakeAll()
+{
+    std::fill(this->wakeDays.begin(), this->wakeDays.end(), 0);
+    this->timers = decltype(this->timers)();
+    this->dirty = true;
+
+    return;
+}
+
+void ActivityTracker::wake(const Map& map, const std::vector<int>& changed)
+{
+    /* Labels of every region touching the changed tiles, per layer */
+    std::vector<unsigned int> labels[numRegionTypes];
+    for(int pos : changed)
+    {
+        int x = pos % map.width;
+        int y = pos / map.width;
+        int neighbours[5] = { pos, -1, -1, -1, -1 };
+        if(x > 0)               neighbours[1] = pos-1;
+        if(y < map.height-1)    neighbours[2] = pos+map.width;
+        if(x < map.width-1)     neighbours[3] = pos+1;
+        if(y > 0)               neighbours[4] = pos-map.width;
+        for(int npos : neighbours)
+        {
+            if(npos < 0) continue;
+            this->wake(npos);
+            for(int type = 0; type < numRegionTypes; ++type)
+            {
+                unsigned int label = map.tiles[npos].regions[type];
+                if(label != 0) labels[type].push_back(label);
+            }
+        }
+    }
+    for(auto& layer : labels)
+    {
+        std::sort(layer.begin(), layer.end());
+        layer.erase(std::unique(layer.begin(), layer.end()), layer.end());
+    }
+
+    for(auto& zone : map.zoneTiles)
+    {
+        for(int pos : zone)
+        {
+            if(!this->isAsleep(pos)) continue;
+            for(int type = 0; type < numRegionTypes; ++type)
+            {
+                if(std::binary_search(labels[type].begin(), labels[type].end(),
+                    map.tiles[pos].regions[type]))
+                {
+                    this->wake(pos);
+                    break;
+                }
+            }
+        }
+    }
+
+    return;
+}
+
+void ActivityTracker::fireTimers(int day, std::vector<int>& fired)
+{
+    while(!this->timers.empty() && this->timers.top().first <= day)
+    {
+        Timer timer = this->timers.top();
+        this->timers.pop();
+        /* Skip timers of tiles that woke, and perhaps slept again, since */
+        if(this->wakeDays[timer.second] != timer.first) continue;
+        this->wake(timer.second);
+        fired.push_back(timer.second);
+    }
+
+    return;
+}
+
+void ActivityTracker::refresh(const Map& map, const std::vector<int>* shuffled)
+{
+    if(this->dirty)
+    {
+        this->wakeDays.resize(map.tiles.size(), 0);
+        this->order.resize(map.tiles.size());
+        this->wasAsleep.assign(map.tiles.size(), false);
+        this->sleepingResidents = 0;
+        for(int zone = 0; zone < 3; ++zone)
+        {
+            this->awake[zone].clear();
+            for(unsigned int k = 0; k < shuffled[zone].size(); ++k)
+            {
+                int pos = shuffled[zone][k];
+                this->order[pos] = k;
+                if(!this->isAsleep(pos))
+                {
+                    this->awake[zone].push_back(pos);
+                    continue;
+                }
+                this->wasAsleep[pos] = true;
+                if(map.tiles[pos].tileType == TileType::RESIDENTIAL)
+                    this->sleepingResidents += map.tiles[pos].population;
+            }
+        }
+        this->changed.clear();
+        this->dirty = false;
+
+        return;
+    }
+
+    /* Only the tiles whose state differs from the last refresh move.
+     * Sleeping zones are full, so have the same residents as when they
+     * fell asleep */
+    bool slept = false;
+    for(int pos : this->changed)
+    {
+        bool asleep = this->isAsleep(pos);
+        if(asleep == this->wasAsleep[pos]) continue;
+        this->wasAsleep[pos] = asleep;
+
+        const Tile& tile = map.tiles[pos];
+        if(tile.tileType == TileType::RESIDENTIAL)
+            this->sleepingResidents += asleep ? tile.population : -tile.population;
+        if(asleep)
+            slept = true;
+        else
+            this->woken[Map::zoneIndex(tile.tileType)].push_back(pos);
+    }
+    this->changed.clear();
+
+    auto inOrder = [this](int a, int b) { return this->order[a] < this->order[b]; };
+    for(int zone = 0; zone < 3; ++zone)
+    {
+        std::vector<int>& awake = this->awake[zone];
+        if(slept)
+        {
+            awake.erase(std::remove_if(awake.begin(), awake.end(), [this](int pos)
+            {
+                return this->isAsleep(pos);
+            }), awake.end());
+        }
+        if(this->woken[zone].empty()) continue;
+
+        std::sort(this->woken[zone].begin(), this->woken[zone].end(), inOrder);
+        std::size_t middle = awake.size();
+        awake.insert(awake.end(), this->woken[zone].begin(), this->woken[zone].end());
+        std::inplace_merge(awake.begin(), awake.begin() + middle, awake.end(), inOrder);
+        this->woken[zone].clear();
+    }
+
+    return;
+}
+
+std::size_t ActivityTracker::getSize() const
+{
+    std::size_t size = vectorSize(this->wakeDays) + vectorSize(this->order) +
+        this->timers.size() * sizeof(Timer) + vectorSize(this->changed) + vectorSize(this->wasAsleep);
+    for(auto& zone : this->awake) size += vectorSize(zone);
+    for(auto& zone : this->woken) size += vectorSize(zone);
+
+    return size;
+}
@@ -0,0 +1,97 @@
+#ifndef ACTIVITY_HPP
+#define ACTIVITY_HPP
+
+#include <climits>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+class Map;
+
+/* Tracks which zones have stopped changing, so the daily update can skip
+ * them. A sleeping zone wakes when its timer fires, when it or a zone in
+ * one of its regions changes, or when everything is woken at once */
+class ActivityTracker
+{
+    private:
+
+    typedef std::pair<int, int> Timer;
+
+    /* Day each tile wakes on, 0 if it is awake */
+    std::vector<int> wakeDays;
+
+    /* Index of each zone in the update order of its type */
+    std::vector<int> order;
+
+    /* Day and position of each sleeping tile's timer, soonest first.
+     * Timers of tiles that have since woken are skipped */
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+
+    /* Awake tiles of each zone, in update order. Indexed by
+     * Map::zoneIndex() */
+    std::vector<int> awake[3];
+
+    /* Tiles that have slept or woken since the last refresh, perhaps
+     * more than once, and whether each tile was asleep at it */
+    std::vector<int> changed;
+    std::vector<bool> wasAsleep;
+
+    /* Tiles of each zone that have woken since the last refresh */
+    std::vector<int> woken[3];
+
+    /* The awake lists must be rebuilt from scratch */
+    bool dirty;
+
+    public:
+
+    /* Wake day of a tile that only an event will wake */
+    const static int never = INT_MAX;
+
+    /* Residents of the sleeping residential zones, valid after
+     * refresh */
+    double sleepingResidents;
+
+    bool isAsleep(int pos) const
+    {
+        return pos < this->wakeDays.size() && this->wakeDays[pos] != 0;
+    }
+
+    void sleep(int pos, int wakeDay);
+    void wake(int pos);
+    void wakeAll();
+
+    /* Wake every zone sharing a region, in any layer, with the tiles at
+     * or next to the given positions */
+    void wake(const Map& map, const std::vector<int>& changed);
+
+    /* Wake the tiles whose timers fire on or before day, adding them
+     * to fired */
+    void fireTimers(int day, std::vector<int>& fired);
+
+    /* The update order has changed */
+    void invalidate() { this->dirty = true; }
+
+    /* Remove the tiles that have slept from the awake lists and merge
+     * in those that have woken. If the order has changed or everything
+     * woke, rebuild the lists from the shuffled zone tiles instead */
+    void refresh(const Map& map, const std::vector<int>* shuffled);
+
+    /* Index of the zone at pos in the update order of its type. Only
+     * valid after refresh */
+    int getOrder(int pos) const { return this->order[pos]; }
+
+    const std::vector<int>& getAwake(int zone) const { return this->awake[zone]; }
+
+    /* Memory used, in bytes */
+    std::size_t getSize() const;
+
+    ActivityTracker()
+    {
+        this->dirty = true;
+        this->sleepingResidents = 0;
+    }
+};
+
+#endif /* ACTIVITY_HPP */
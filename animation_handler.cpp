@@ -44,6 +44,23 @@ void AnimationHandler::addAnim(Animation& anim)
     return;
 }
 
+sf::IntRect AnimationHandler::getFrame(unsigned int animID) const
+{
+    sf::IntRect rect = this->frameSize;
+    if(this->animations.empty()) return rect;
+
+    /* Nonexistent animations show the last one instead */
+    if(animID >= this->animations.size()) animID = this->animations.size()-1;
+
+    const Animation& anim = this->animations[animID];
+    int frame = int(this->t / anim.duration) % anim.getLength();
+
+    rect.left = rect.width * frame;
+    rect.top = rect.height * animID;
+
+    return rect;
+}
+
 void AnimationHandler::changeAnim(unsigned int animID)
 {
     /* Do not change the animation if the animation is currently active or
@@ -20,7 +20,7 @@ class Animation
         this->duration = duration;
     }
 
-    unsigned int getLength() { return endFrame - startFrame + 1; }
+    unsigned int getLength() const { return endFrame - startFrame + 1; }
 };
 
 class AnimationHandler
@@ -48,6 +48,11 @@ class AnimationHandler
     /* Change the animation, resetting t in the process */
     void changeAnim(unsigned int animNum);
 
+    /* Section of the texture that should be displayed for the given
+     * animation at the current time, allowing one handler to be shared
+     * by sprites showing different animations */
+    sf::IntRect getFrame(unsigned int animNum) const;
+
     /* Current section of the texture that should be displayed */
     sf::IntRect bounds;
 
@@ -0,0 +1,101 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+/* Fixed size queue that any number of threads can push to while a single
+ * thread pops from it, without taking a lock. Each slot holds a sequence
+ * number saying whose turn it is to use it, so producers only contend on
+ * the index of the next slot to fill */
+template<typename T>
+class BoundedQueue
+{
+    private:
+
+    class Slot
+    {
+        public:
+
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    std::size_t mask;
+
+    /* Index of the next slot to fill, and of the next to empty */
+    std::atomic<std::size_t> tail;
+    std::size_t head;
+
+    public:
+
+    /* Add a value to the queue from any thread. Returns false if the
+     * queue is full */
+    bool push(const T& value)
+    {
+        std::size_t pos = this->tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        while(true)
+        {
+            slot = &this->slots[pos & this->mask];
+            std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(pos);
+
+            /* The slot is empty, so claim it */
+            if(diff == 0)
+            {
+                if(this->tail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) break;
+            }
+            /* The slot still holds a value from a lap ago */
+            else if(diff < 0)
+            {
+                return false;
+            }
+            /* Another producer claimed the slot first */
+            else
+            {
+                pos = this->tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->value = value;
+        slot->sequence.store(pos+1, std::memory_order_release);
+
+        return true;
+    }
+
+    /* Take the oldest value from the queue. Only one thread may pop.
+     * Returns false if the queue is empty */
+    bool pop(T& value)
+    {
+        Slot& slot = this->slots[this->head & this->mask];
+        if(slot.sequence.load(std::memory_order_acquire) != this->head + 1) return false;
+
+        value = std::move(slot.value);
+
+        /* Hand the slot back to the producers for their next lap */
+        slot.sequence.store(this->head + this->mask + 1, std::memory_order_release);
+        ++this->head;
+
+        return true;
+    }
+
+    std::size_t capacity() const { return this->mask + 1; }
+
+    /* The capacity is rounded up to a power of two */
+    BoundedQueue(std::size_t capacity = 256)
+    {
+        std::size_t size = 1;
+        while(size < capacity) size *= 2;
+
+        this->slots.reset(new Slot[size]);
+        for(std::size_t i = 0; i < size; ++i) this->slots[i].sequence = i;
+        this->mask = size - 1;
+        this->tail = 0;
+        this->head = 0;
+    }
+};
+
+#endif /* BOUNDED_QUEUE_HPP */
@@ -5,15 +5,51 @@
 #include <vector>
 #include <fstream>
 #include <sstream>
+#include <cstdint>
 
 #include "city.hpp"
 #include "tile.hpp"
+#include "trace.hpp"
+#include "memory.hpp"
+
+/* First producer at or after i with anything left, halving the path
+ * to it on the way */
+static int findProducer(std::vector<int>& next, int i)
+{
+    while(next[i] != i)
+    {
+        next[i] = next[next[i]];
+        i = next[i];
+    }
+
+    return i;
+}
+
+/* Tiles that a tile of the given type cannot be placed on. Flattening
+ * can replace anything but water, every other tile can only be placed
+ * on empty land */
+static TileTypeSet placementBlacklist(TileType tileType)
+{
+    if(tileType == TileType::GRASS) return tileType | TileType::WATER;
+
+    return
+        tileType                | TileType::FOREST      |
+        TileType::WATER         | TileType::ROAD        |
+        TileType::RESIDENTIAL   | TileType::COMMERCIAL  |
+        TileType::INDUSTRIAL;
+}
+
+/* Sorts producers by transport region, and then map order */
+static std::uint64_t producerKey(const Tile& tile, int pos)
+{
+    return std::uint64_t(tile.regions[0]) << 32 | std::uint32_t(pos);
+}
 
 double City::distributePool(double& pool, Tile& tile, double rate = 0.0)
 {
     const static int moveRate = 4;
 
-    unsigned int maxPop = tile.maxPopPerLevel * (tile.tileVariant+1);
+    unsigned int maxPop = this->map.getPrototype(tile).maxPopPerLevel * (tile.tileVariant+1);
 
     /* If there is room in the zone, move up to 4 people from the
      * pool into the zone */
@@ -40,59 +76,381 @@ double City::distributePool(double& pool, Tile& tile, double rate = 0.0)
     return tile.population;
 }
 
-void City::bulldoze(const Tile& tile)
+void City::releasePopulation(const Tile& tile)
+{
+    if(tile.tileType == TileType::RESIDENTIAL)
+    {
+        this->populationPool += tile.population;
+    }
+    else if(tile.tileType == TileType::COMMERCIAL)
+    {
+        this->employmentPool += tile.population;
+    }
+    else if(tile.tileType == TileType::INDUSTRIAL)
+    {
+        this->employmentPool += tile.population;
+    }
+
+    return;
+}
+
+double City::takePopulation(TileType tileType, double population)
+{
+    double* pool = nullptr;
+    if(tileType == TileType::RESIDENTIAL)       pool = &this->populationPool;
+    else if(tileType == TileType::COMMERCIAL)   pool = &this->employmentPool;
+    else if(tileType == TileType::INDUSTRIAL)   pool = &this->employmentPool;
+    if(pool == nullptr) return 0;
+
+    /* The pool may have shrunk since the population was released */
+    if(population > *pool) population = *pool > 0 ? *pool : 0;
+    *pool -= population;
+
+    return population;
+}
+
+void City::bulldoze(TileType tileType, const Selection& selection, Edit& edit)
 {
     /* Replace the selected tiles on the map with the tile and
      * update populations etc accordingly */
-    for(int pos = 0; pos < this->map.width * this->map.height; ++pos)
+    std::vector<int> changed;
+    selection.forEachSelected([this, &edit, &changed](int pos)
     {
-        if(this->map.selected[pos] == 1)
-        {
-            if(this->map.tiles[pos].tileType == TileType::RESIDENTIAL)
-            {
-                this->populationPool += this->map.tiles[pos].population;
-            }
-            else if(this->map.tiles[pos].tileType == TileType::COMMERCIAL)
-            {
-                this->employmentPool += this->map.tiles[pos].population;
-            }
-            else if(this->map.tiles[pos].tileType == TileType::INDUSTRIAL)
-            {
-                this->employmentPool += this->map.tiles[pos].population;
-            }
-            this->map.tiles[pos] = tile;
-        }
-    }
+        edit.diffs.push_back(TileDiff(pos, this->map.tiles[pos], this->map.tiles[pos].population));
+        this->releasePopulation(this->map.tiles[pos]);
+        changed.push_back(pos);
+    });
+    this->map.setTiles(changed, std::vector<Tile>(changed.size(), Tile(tileType)));
+
+    /* Include any new zones in the update order */
+    this->reshuffleTiles(changed);
 
     return;
 }
 
 void City::shuffleTiles()
 {
-    while(this->shuffledTiles.size() < this->map.tiles.size())
+    for(int zone = 0; zone < 3; ++zone)
+    {
+        std::vector<int>& shuffled = this->shuffledTiles[zone];
+        shuffled = this->map.zoneTiles[zone];
+
+        /* std::shuffle is implemented differently by each standard
+         * library, so shuffle by hand to keep the order, and the golden
+         * records, the same on every platform */
+        for(int i = int(shuffled.size())-1; i > 0; --i)
+            std::swap(shuffled[i], shuffled[this->random() % (i+1)]);
+    }
+    this->activity.invalidate();
+    this->regionsDirty = true;
+
+    return;
+}
+
+void City::reshuffleTiles(const std::vector<int>& changed)
+{
+    std::vector<int> sorted = changed;
+    std::sort(sorted.begin(), sorted.end());
+
+    for(int zone = 0; zone < 3; ++zone)
     {
-        this->shuffledTiles.push_back(0);
+        std::vector<int>& shuffled = this->shuffledTiles[zone];
+        shuffled.erase(std::remove_if(shuffled.begin(), shuffled.end(), [&sorted](int pos)
+        {
+            return std::binary_search(sorted.begin(), sorted.end(), pos);
+        }), shuffled.end());
+
+        /* Swapping each new tile with a random one keeps the order as
+         * random as a full shuffle */
+        for(int pos : changed)
+        {
+            if(Map::zoneIndex(this->map.tiles[pos].tileType) != zone) continue;
+            shuffled.push_back(pos);
+            std::swap(shuffled.back(), shuffled[this->random() % shuffled.size()]);
+        }
     }
-    std::iota(shuffledTiles.begin(), shuffledTiles.end(), 1);
-    std::random_shuffle(shuffledTiles.begin(), shuffledTiles.end());
+    this->activity.invalidate();
+    this->regionsDirty = true;
 
     return;
 }
 
+const TileTypeSet City::regionTiles[numRegionTypes] =
+{
+    TileType::ROAD          | TileType::RESIDENTIAL |
+    TileType::COMMERCIAL    | TileType::INDUSTRIAL,
+    UtilityNetworks::waterTiles
+};
+
 void City::tileChanged()
 {
+    TraceZone zone("City::tileChanged");
     this->map.updateDirection(TileType::ROAD);
-    this->map.findConnectedRegions(
+    /* Label every layer in one pass */
+    this->map.findConnectedRegions(regionTiles, 0, numRegionTypes);
+    this->map.roads.build(this->map);
+    this->commute.invalidateAll();
+    this->pathfinder.invalidateAll();
+    this->fields.rebuild(this->map);
+    this->changedFields.resize(this->map.width, this->map.height);
+    this->utilities.invalidate();
+    this->activity.wakeAll();
+    this->regionsDirty = true;
+
+    return;
+}
+
+void City::tileChanged(const std::vector<int>& changed)
+{
+    TraceZone zone("City::tileChanged");
+    /* Regions may be split, joined or relabelled, so invalidate them
+     * both before and after */
+    this->invalidateCommute(changed);
+    this->map.updateDirection(TileType::ROAD, changed);
+    for(int type = 0; type < numRegionTypes; ++type)
+    {
+        this->map.updateConnectedRegions(regionTiles[type], type, changed);
+    }
+    this->map.roads.update(this->map, changed);
+    this->invalidateCommute(changed);
+    this->pathfinder.invalidate(this->map, changed);
+    this->utilities.invalidate();
+    this->activity.wake(this->map, changed);
+    this->regionsDirty = true;
+
+    return;
+}
+
+void City::invalidateCommute(const std::vector<int>& changed)
+{
+    for(int pos : changed)
+    {
+        int x = pos % this->map.width;
+        int y = pos / this->map.width;
+        this->commute.invalidate(this->map.tiles[pos].regions[0]);
+        if(x > 0)                       this->commute.invalidate(this->map.tiles[pos-1].regions[0]);
+        if(y < this->map.height-1)      this->commute.invalidate(this->map.tiles[pos+this->map.width].regions[0]);
+        if(x < this->map.width-1)       this->commute.invalidate(this->map.tiles[pos+1].regions[0]);
+        if(y > 0)                       this->commute.invalidate(this->map.tiles[pos-this->map.width].regions[0]);
+    }
+
+    return;
+}
+
+void City::indexRegions()
+{
+    unsigned int numRegions = this->map.numRegions[int(RegionType::TRANSPORT)];
+
+    /* Counting sort each zone's update order by region, which keeps
+     * the zones of a region in update order */
+    for(int zone = 0; zone < 3; ++zone)
+    {
+        std::vector<unsigned int>& starts = this->regionStarts[zone];
+        starts.assign(numRegions+1, 0);
+        for(int pos : this->shuffledTiles[zone]) ++starts[this->map.tiles[pos].regions[0]+1];
+        for(unsigned int r = 1; r <= numRegions; ++r) starts[r] += starts[r-1];
+        this->regionZones[zone].resize(this->shuffledTiles[zone].size());
+        for(int pos : this->shuffledTiles[zone])
+            this->regionZones[zone][starts[this->map.tiles[pos].regions[0]]++] = pos;
+        /* Filling the regions moved each start on to the next region's */
+        for(unsigned int r = numRegions; r > 0; --r) starts[r] = starts[r-1];
+        starts[0] = 0;
+    }
+
+    /* Edits can restore production and goods as well as remove them */
+    this->producers.clear();
+    this->stocked.clear();
+    for(int pos : this->map.zoneTiles[Map::zoneIndex(TileType::INDUSTRIAL)])
+    {
+        if(this->map.tiles[pos].production > 0) this->producers.push_back(producerKey(this->map.tiles[pos], pos));
+        if(this->map.tiles[pos].storedGoods > 0) this->stocked.push_back(pos);
+    }
+    this->regionTotals.rebuild(this->map);
+
+    /* Reaches only change with the regions */
+    this->commute.refresh(this->map);
+    std::vector<Household>& households = this->commute.households;
+    std::fill(households.begin(), households.end(), Household());
+    for(int pos : this->map.zoneTiles[Map::zoneIndex(TileType::RESIDENTIAL)])
+    {
+        int household = this->commute.getHousehold(pos);
+        if(household >= 0) households[household].residents = this->map.tiles[pos].population;
+    }
+    for(int pos : this->map.zoneTiles[Map::zoneIndex(TileType::COMMERCIAL)])
+    {
+        const Tile& tile = this->map.tiles[pos];
+        Reach& reach = this->commute.getReach(pos);
+        reach.perCustomer = tile.production * tile.population / 100.0;
+        for(int household : reach.residential) households[household].spending += reach.perCustomer;
+    }
+    this->commercialRevenue = 0;
+    for(auto& household : households) this->commercialRevenue += household.residents * household.spending;
+    this->regionsDirty = false;
+
+    return;
+}
+
+void City::populationChanged(int pos, const Tile& tile, double delta)
+{
+    if(delta == 0) return;
+    this->regionTotals.add(tile, delta);
+
+    /* Commercial zones that hire are awake, so will trade today and
+     * take their new workers into account then */
+    if(tile.tileType != TileType::RESIDENTIAL) return;
+    int household = this->commute.getHousehold(pos);
+    if(household < 0) return;
+    Household& residents = this->commute.households[household];
+    this->commercialRevenue += delta * residents.spending;
+    residents.residents = tile.population;
+
+    return;
+}
+
+float City::getDesirability(const Tile& tile, int pos) const
+{
+    float desirability = this->fields.getDesirability(tile.tileType,
+        pos % this->map.width, pos / this->map.width);
+
+    return desirability * (0.5f + 0.5f * this->utilities.getSupply(tile));
+}
+
+void City::sleepIfSteady(int pos, const Tile& tile, float desirability)
+{
+    const TilePrototype& prototype = this->map.getPrototype(tile);
+
+    /* A full zone takes no one from the pools, so only changes when it
+     * levels up. Residents must not be dying out, and industry must
+     * have nothing left to extract */
+    if(tile.population != prototype.maxPopPerLevel * (tile.tileVariant+1)) return;
+    if(tile.tileType == TileType::RESIDENTIAL && this->birthRate < this->deathRate) return;
+    if(tile.tileType == TileType::INDUSTRIAL && this->map.resources[pos] > 0) return;
+
+    /* Draw the number of days until the daily level up roll in
+     * Tile::update would first succeed */
+    int wakeDay = ActivityTracker::never;
+    double chance = 1e2 / (tile.tileVariant+1) * desirability / 1e4;
+    if(tile.tileVariant < prototype.maxLevels && chance > 0)
+    {
+        double u = (this->random() + 1.0) / (std::mt19937::max() + 1.0);
+        double days = chance < 1 ? std::ceil(std::log(u) / std::log(1 - chance)) : 1;
+        if(days < ActivityTracker::never - this->day) wakeDay = this->day + std::max(int(days), 1);
+    }
+    this->activity.sleep(pos, wakeDay);
+
+    return;
+}
+
+void City::rearm(int pos)
+{
+    if(!this->activity.isAsleep(pos)) return;
+
+    /* The chance of levelling up each day does not depend on how long
+     * the zone has waited, so a new draw from today is as good as the
+     * one it replaces */
+    const Tile& tile = this->map.tiles[pos];
+    this->sleepIfSteady(pos, tile, this->getDesirability(tile, pos));
+
+    return;
+}
+
+void City::selectForPlacement(sf::Vector2i start, sf::Vector2i end, TileType tileType)
+{
+    this->map.select(start, end, placementBlacklist(tileType));
+
+    return;
+}
+
+unsigned int City::placeTiles(const TilePrototype& prototype, sf::Vector2i start, sf::Vector2i end)
+{
+    /* Select into a selection of our own, so that placing never
+     * disturbs whatever the player is selecting at the time */
+    Selection placing;
+    placing.resize(this->map.width, this->map.height);
+    this->map.select(placing, start, end, placementBlacklist(prototype.tileType));
+
+    unsigned int cost = prototype.cost * placing.count();
+    if(this->funds < cost) return 0;
+
+    Edit edit(prototype.tileType, cost);
+    this->bulldoze(prototype.tileType, placing, edit);
+    this->funds -= cost;
+
+    std::vector<int> changed;
+    for(auto& diff : edit.diffs) changed.push_back(diff.pos);
+    this->tileChanged(changed);
+
+    this->history.push(std::move(edit));
+
+    return cost;
+}
+
+void City::swapTiles(Edit& edit)
+{
+    /* The tiles on the map may have gained residents or workers since,
+     * so release them all before restoring the diffs' tiles */
+    std::vector<int> changed;
+    for(auto& diff : edit.diffs)
+    {
+        this->releasePopulation(this->map.tiles[diff.pos]);
+        changed.push_back(diff.pos);
+    }
+
+    /* Reverse each diff's pool delta. If those people have since left
+     * the pool, the tile is restored without them */
+    std::vector<Tile> tiles;
+    for(auto& diff : edit.diffs)
     {
-        TileType::ROAD, TileType::RESIDENTIAL,
-        TileType::COMMERCIAL, TileType::INDUSTRIAL
-    }, 0);
+        Tile tile(TileType(diff.tileType));
+        tile.tileVariant = diff.tileVariant;
+        tile.production = diff.production;
+        tile.storedGoods = diff.storedGoods;
+        double taken = this->takePopulation(tile.tileType, diff.poolDelta);
+        tile.population = diff.population - (diff.poolDelta - taken);
+        tiles.push_back(tile);
+
+        const Tile& current = this->map.tiles[diff.pos];
+        diff = TileDiff(diff.pos, current, current.population);
+    }
+    this->map.setTiles(changed, tiles);
+
+    this->reshuffleTiles(changed);
+    this->tileChanged(changed);
 
     return;
 }
 
-void City::load(std::string cityName, std::map<std::string, Tile>& tileAtlas)
+bool City::undo()
+{
+    if(!this->history.canUndo()) return false;
+
+    Edit edit = this->history.popUndo();
+    this->swapTiles(edit);
+    this->funds += edit.cost;
+
+    this->history.pushRedo(std::move(edit));
+
+    return true;
+}
+
+bool City::redo()
+{
+    if(!this->history.canRedo()) return false;
+    if(this->funds < this->history.nextRedo().cost) return false;
+
+    /* Put back the placed tiles as they were when they were undone */
+    Edit edit = this->history.popRedo();
+    this->swapTiles(edit);
+    this->funds -= edit.cost;
+
+    this->history.pushUndo(std::move(edit));
+
+    return true;
+}
+
+void City::load(std::string cityName, TileAtlas& tileAtlas)
 {
+    TraceZone zone("City::load");
 	int width = 0;
 	int height = 0;
 	
@@ -123,6 +481,7 @@ void City::load(std::string cityName, std::map<std::string, Tile>& tileAtlas)
 		            else if(key == "industrialTax")     this->industrialTax     = std::stod(value);
 		            else if(key == "funds")             this->funds             = std::stod(value);
 		            else if(key == "earnings")          this->earnings          = std::stod(value);
+		            else if(key == "commuteDistance")   this->commute.distance  = std::stoul(value);
 	            }
 	            else
 	            {
@@ -134,6 +493,8 @@ void City::load(std::string cityName, std::map<std::string, Tile>& tileAtlas)
 	inputFile.close();
 	
 	this->map.load(cityName + "_map.dat", width, height, tileAtlas);
+	this->history.clear();
+	this->stats.clear();
 	tileChanged();
 	
 	return;
@@ -141,6 +502,7 @@ void City::load(std::string cityName, std::map<std::string, Tile>& tileAtlas)
 
 void City::save(std::string cityName)
 {
+    TraceZone zone("City::save");
     std::ofstream outputFile(cityName + "_cfg.dat", std::ios::out);
     
     outputFile << "width="              << this->map.width          << std::endl;
@@ -157,6 +519,7 @@ void City::save(std::string cityName)
     outputFile << "industrialTax="      << this->industrialTax      << std::endl;
     outputFile << "funds="              << this->funds              << std::endl;
     outputFile << "earnings="           << this->earnings           << std::endl;
+    outputFile << "commuteDistance="    << this->commute.distance   << std::endl;
     
     outputFile.close();
     
@@ -165,117 +528,277 @@ void City::save(std::string cityName)
     return;
 }
     
-void City::update(float dt)
+void City::update(float dt, const std::function<void()>& betweenDays)
 {
-    double popTotal = 0;
-    double commercialRevenue = 0;
-    double industrialRevenue = 0;
+    /* A paused city stays between days */
+    if(this->paused)
+    {
+        if(betweenDays) betweenDays();
+        return;
+    }
 
     /* Update the game time */
-    this->currentTime += dt;
+    this->currentTime += dt * this->speed;
     if(this->currentTime < this->timePerDay) return;
-    ++day;
     this->currentTime = 0.0;
+
+    if(betweenDays) betweenDays();
+    /* The changes may have paused the city */
+    if(this->paused) return;
+
+    this->simulateDay();
+
+    return;
+}
+
+void City::simulateDay()
+{
+    TraceZone zone("City::simulateDay");
+    TraceZone pass("fields and utilities");
+
+    double popTotal = 0;
+    double industrialRevenue = 0;
+
+    ++day;
     if(day % 30 == 0)
     {
         this->funds += this->earnings;
         this->earnings = 0;
     }
+
+    if(this->regionsDirty) this->indexRegions();
+
+    /* Spread the rebuild of the fields across the days */
+    this->fields.update(this->map, this->changedFields);
+    this->changedRegions.clear();
+    this->utilities.update(this->map, this->changedRegions);
+
+    /* Sleeping zones drew their timers with the desirability they had
+     * when they fell asleep, so draw them again wherever it changes.
+     * Edits wake the zones whose supply they change instead */
+    pass.next("rearm timers");
+    this->changedFields.forEachSelected([this](int pos)
+    {
+        /* Fields do not affect industry */
+        if(this->map.tiles[pos].tileType != TileType::INDUSTRIAL) this->rearm(pos);
+    });
+    this->changedFields.clear();
+    for(unsigned int region : this->changedRegions)
+    {
+        for(int zone = 0; zone < 3; ++zone)
+        {
+            for(unsigned int k = this->regionStarts[zone][region]; k < this->regionStarts[zone][region+1]; ++k)
+                this->rearm(this->regionZones[zone][k]);
+        }
+    }
+
+    /* Zones whose timers fire level up, leaving them room to grow */
+    pass.next("sleep timers");
+    this->firedTimers.clear();
+    this->activity.fireTimers(this->day, this->firedTimers);
+    for(int pos : this->firedTimers)
+    {
+        Tile& tile = this->map.tiles[pos];
+        if(tile.tileVariant >= this->map.getPrototype(tile).maxLevels) continue;
+        ++tile.tileVariant;
+        if(tile.tileType == TileType::INDUSTRIAL) this->utilities.levelUp(tile);
+    }
+
+    /* Only the awake zones are updated in the first pass. Sleeping
+     * residential zones are full, so all of their births join the pool */
+    this->activity.refresh(this->map, this->shuffledTiles);
+    const std::vector<int>& awakeResidential = this->activity.getAwake(Map::zoneIndex(TileType::RESIDENTIAL));
+    const std::vector<int>& awakeCommercial = this->activity.getAwake(Map::zoneIndex(TileType::COMMERCIAL));
+    const std::vector<int>& awakeIndustrial = this->activity.getAwake(Map::zoneIndex(TileType::INDUSTRIAL));
+    popTotal += this->activity.sleepingResidents;
+    this->populationPool += this->activity.sleepingResidents * (this->birthRate - this->deathRate);
+
     /* Run first pass of tile updates. Mostly handles pool distribution */
-    for(int i = 0; i < this->map.tiles.size(); ++i)
+    pass.next("pass 1");
+    this->packedPopulation.resize(awakeResidential.size());
+    this->packedCapacity.resize(awakeResidential.size());
+    for(int k = 0; k < awakeResidential.size(); ++k)
     {
-        Tile& tile = this->map.tiles[this->shuffledTiles[i]];
+        const Tile& tile = this->map.tiles[awakeResidential[k]];
+        this->packedPopulation[k] = tile.population;
+        this->packedCapacity[k] = this->map.getPrototype(tile).maxPopPerLevel * (tile.tileVariant+1);
+    }
 
-        if(tile.tileType == TileType::RESIDENTIAL)
-        {
-            /* Redistribute the pool and increase the population total by the tile's population */
-            this->distributePool(this->populationPool, tile, this->birthRate - this->deathRate);
+    /* Redistribute the pool across every residential zone at once */
+    distributeResidents(this->packedPopulation.data(), this->packedCapacity.data(),
+        awakeResidential.size(), this->populationPool, this->birthRate - this->deathRate,
+        this->growthKernel);
 
-            popTotal += tile.population;
-        }
-        else if(tile.tileType == TileType::COMMERCIAL)
+    for(int k = 0; k < awakeResidential.size(); ++k)
+    {
+        Tile& tile = this->map.tiles[awakeResidential[k]];
+        double delta = this->packedPopulation[k] - tile.population;
+        tile.population = this->packedPopulation[k];
+        this->populationChanged(awakeResidential[k], tile, delta);
+
+        /* Increase the population total by the tile's population */
+        popTotal += tile.population;
+
+        float desirability = this->getDesirability(tile, awakeResidential[k]);
+        tile.update(this->map.getPrototype(tile), this->random, desirability);
+        this->sleepIfSteady(awakeResidential[k], tile, desirability);
+    }
+    /* Alternate between commercial and industrial tiles in proportion
+     * to their numbers, so that neither is always first to hire */
+    for(int c = 0, i = 0; c < awakeCommercial.size() || i < awakeIndustrial.size();)
+    {
+        bool isCommercial = i >= awakeIndustrial.size() ||
+            (c < awakeCommercial.size() && c * awakeIndustrial.size() <= i * awakeCommercial.size());
+        int pos = isCommercial ? awakeCommercial[c++] : awakeIndustrial[i++];
+        Tile& tile = this->map.tiles[pos];
+        double workers = tile.population;
+
+        if(isCommercial)
         {
             /* Hire people */
-            if(rand() % 100 < 15 * (1.0-this->commercialTax))
+            if(this->random() % 100 < 15 * (1.0-this->commercialTax))
                 this->distributePool(this->employmentPool, tile, 0.00);
         }
-        else if(tile.tileType == TileType::INDUSTRIAL)
+        else
         {
             /* Extract resources from the ground */
-            if(this->map.resources[i] > 0 && rand() % 100 < this->population)
+            if(this->map.resources[pos] > 0 && this->random() % 100 < this->population)
             {
                 ++tile.production;
-                --this->map.resources[i];
+                --this->map.resources[pos];
+                this->producers.push_back(producerKey(tile, pos));
             }
             /* Hire people */
-            if(rand() % 100 < 15 * (1.0-this->industrialTax))
+            if(this->random() % 100 < 15 * (1.0-this->industrialTax))
                 this->distributePool(this->employmentPool, tile, 0.0);
         }
 
-        tile.update();
+        this->populationChanged(pos, tile, tile.population - workers);
+
+        float desirability = this->getDesirability(tile, pos);
+        unsigned int variant = tile.tileVariant;
+        tile.update(this->map.getPrototype(tile), this->random, desirability);
+        if(!isCommercial && tile.tileVariant != variant) this->utilities.levelUp(tile);
+        this->sleepIfSteady(pos, tile, desirability);
     }
-	/* Run second pass. Mostly handles goods manufacture */
-    for(int i = 0; i < this->map.tiles.size(); ++i)
+	/* Run second pass. Mostly handles goods manufacture. Only zones
+	 * with something to give need to be searched for resources */
+    pass.next("pass 2");
+    const int industrialZone = Map::zoneIndex(TileType::INDUSTRIAL);
+    this->producers.erase(std::remove_if(this->producers.begin(), this->producers.end(), [this](std::uint64_t key)
+    {
+        return this->map.tiles[std::uint32_t(key)].production <= 0;
+    }), this->producers.end());
+    std::sort(this->producers.begin(), this->producers.end());
+    this->producers.erase(std::unique(this->producers.begin(), this->producers.end()), this->producers.end());
+    this->nextProducer.resize(this->producers.size()+1);
+    for(unsigned int i = 0; i < this->nextProducer.size(); ++i) this->nextProducer[i] = i;
+
+    /* Regions without producers have nothing to make goods from */
+    for(unsigned int first = 0, last = 0; first < this->producers.size(); first = last)
     {
-        Tile& tile = this->map.tiles[this->shuffledTiles[i]];
+        std::uint32_t region = this->producers[first] >> 32;
+        float remaining = 0;
+        for(; last < this->producers.size() && (this->producers[last] >> 32) == region; ++last)
+            remaining += this->map.tiles[std::uint32_t(this->producers[last])].production;
 
-        if(tile.tileType == TileType::INDUSTRIAL)
+        /* Once the region's production has all been used, every zone
+         * after would make nothing */
+        for(unsigned int k = this->regionStarts[industrialZone][region];
+            k < this->regionStarts[industrialZone][region+1] && remaining > 0; ++k)
         {
+            Tile& tile = this->map.tiles[this->regionZones[industrialZone][k]];
+
             int receivedResources = 0;
-            /* Receive resources from smaller and connected zones */
-            for(auto& tile2 : this->map.tiles)
+            /* Receive resources from the first connected zones with any left,
+             * skipping those that have run out */
+            for(int i = findProducer(this->nextProducer, first);
+                i < last && receivedResources < tile.tileVariant+1;
+                i = findProducer(this->nextProducer, i+1))
             {
-                if(tile2.regions[0] == tile.regions[0] && tile2.tileType == TileType::INDUSTRIAL)
-                {
-                    if(tile2.production > 0)
-                    {
-                        ++receivedResources;
-                        --tile2.production;
-                    }
-                    if(receivedResources >= tile.tileVariant+1) break;
-                }
+                Tile& tile2 = this->map.tiles[std::uint32_t(this->producers[i])];
+                ++receivedResources;
+                --tile2.production;
+                --remaining;
+                if(tile2.production <= 0) this->nextProducer[i] = i+1;
             }
             /* Turn resources into goods */
+            if(receivedResources+tile.production <= 0) continue;
             tile.storedGoods += (receivedResources+tile.production)*(tile.tileVariant+1);
+            this->stocked.push_back(this->regionZones[industrialZone][k]);
         }
     }
-	/* Run third pass. Mostly handles goods distribution */
-    for(int i = 0; i < this->map.tiles.size(); ++i)
+	/* Run third pass. Mostly handles goods distribution. Commercial
+	 * zones only trade when awake or when there are goods in reach, and
+	 * otherwise keep their production, so only those zones are visited */
+    pass.next("pass 3");
+    this->trading.clear();
+    for(int pos : awakeCommercial)
+    {
+        Reach& reach = this->commute.getReach(pos);
+        reach.tradeDay = this->day;
+        this->trading.push_back(&reach);
+    }
+    std::size_t numAwake = this->trading.size();
+    for(int pos : this->stocked)
+    {
+        for(Reach* shop : this->commute.getShops(pos))
+        {
+            if(shop->tradeDay == this->day) continue;
+            shop->tradeDay = this->day;
+            this->trading.push_back(shop);
+        }
+    }
+    if(this->trading.size() > numAwake)
+    {
+        std::sort(this->trading.begin(), this->trading.end(), [this](const Reach* a, const Reach* b)
+        {
+            return this->activity.getOrder(a->pos) < this->activity.getOrder(b->pos);
+        });
+    }
+    for(Reach* shop : this->trading)
     {
-        Tile& tile = this->map.tiles[this->shuffledTiles[i]];
+        Reach& reach = *shop;
+        Tile& tile = this->map.tiles[reach.pos];
 
-        if(tile.tileType == TileType::COMMERCIAL)
+        int receivedGoods = 0;
+        /* Buy goods from the industrial zones within reach */
+        for(int pos2 : reach.industrial)
         {
-            int receivedGoods = 0;
-            double maxCustomers = 0.0;
-            for(auto& tile2 : this->map.tiles)
+            if(receivedGoods == tile.tileVariant+1) break;
+
+            Tile& tile2 = this->map.tiles[pos2];
+            while(tile2.storedGoods > 0 && receivedGoods != tile.tileVariant+1)
             {
-                if(tile2.regions[0] == tile.regions[0] &&
-                    tile2.tileType == TileType::INDUSTRIAL &&
-                    tile2.storedGoods > 0)
-                {
-                    while(tile2.storedGoods > 0 && receivedGoods != tile.tileVariant+1)
-                    {
-                        --tile2.storedGoods;
-                        ++receivedGoods;
-                        industrialRevenue += 100 * (1.0-industrialTax);
-                    }
-                }
-                else if(tile2.regions[0] == tile.regions[0] &&
-                    tile2.tileType == TileType::RESIDENTIAL)
-                {
-                    maxCustomers += tile2.population;
-                }
-                if(receivedGoods == tile.tileVariant+1) break;
+                --tile2.storedGoods;
+                ++receivedGoods;
+                industrialRevenue += 100 * (1.0-industrialTax);
             }
-            /* Calculate the overall revenue for the tile */
-            tile.production = (receivedGoods*100.0 + rand() % 20) * (1.0-this->commercialTax);
-
-            double revenue = tile.production * maxCustomers * tile.population / 100.0;
-            commercialRevenue += revenue;
         }
+        /* Calculate the overall revenue for the tile. Only residents
+         * within commuting distance shop here, all of them whether or
+         * not the goods ran out */
+        tile.production = (receivedGoods*100.0 + this->random() % 20) * (1.0-this->commercialTax);
+        double change = tile.production * tile.population / 100.0 - reach.perCustomer;
+        if(change == 0) continue;
+        double customers = 0;
+        for(int household : reach.residential)
+        {
+            Household& residents = this->commute.households[household];
+            residents.spending += change;
+            customers += residents.residents;
+        }
+        this->commercialRevenue += change * customers;
+        reach.perCustomer += change;
     }
+    this->stocked.erase(std::remove_if(this->stocked.begin(), this->stocked.end(), [this](int pos)
+    {
+        return this->map.tiles[pos].storedGoods <= 0;
+    }), this->stocked.end());
+    std::sort(this->stocked.begin(), this->stocked.end());
+    this->stocked.erase(std::unique(this->stocked.begin(), this->stocked.end()), this->stocked.end());
 	/* Adjust population pool for births and deaths */
+    pass.next("totals and statistics");
     this->populationPool += this->populationPool * (this->birthRate - this->deathRate);
     popTotal += this->populationPool;
 
@@ -292,8 +815,43 @@ void City::update(float dt)
 
     /* Calculate city income from tax */
     this->earnings = (this->population - this->populationPool) * 15 * this->residentialTax;
-    this->earnings += commercialRevenue * this->commercialTax;
+    this->earnings += this->commercialRevenue * this->commercialTax;
     this->earnings += industrialRevenue * this->industrialTax;
 
+    this->stats.record(*this);
+
+    return;
+}
+
+void City::getMemory(MemoryReport& report) const
+{
+    std::size_t zoneLists = 0;
+    for(auto& zone : this->map.zoneTiles) zoneLists += vectorSize(zone);
+    std::size_t shuffled = 0;
+    for(auto& zone : this->shuffledTiles) shuffled += vectorSize(zone);
+
+    report.add("map tiles", vectorSize(this->map.tiles));
+    report.add("map resources", vectorSize(this->map.resources));
+    report.add("map selection", this->map.selected.getSize());
+    report.add("zone lists", zoneLists);
+    report.add("shuffled tiles", shuffled);
+    std::size_t regionZones = 0;
+    for(int zone = 0; zone < 3; ++zone)
+        regionZones += vectorSize(this->regionZones[zone]) + vectorSize(this->regionStarts[zone]);
+
+    report.add("growth buffers", vectorSize(this->packedPopulation) + vectorSize(this->packedCapacity) +
+        vectorSize(this->firedTimers) + this->changedFields.getSize() + vectorSize(this->changedRegions) +
+        vectorSize(this->producers) + vectorSize(this->nextProducer) + vectorSize(this->stocked) +
+        vectorSize(this->trading));
+    report.add("region zones", regionZones);
+    report.add("road network", this->map.roads.getSize());
+    report.add("pathfinder", this->pathfinder.getSize());
+    report.add("commute cache", this->commute.getSize());
+    report.add("fields", this->fields.getSize());
+    report.add("utilities", this->utilities.getSize());
+    report.add("activity", this->activity.getSize());
+    report.add("statistics", this->stats.getSize() + this->regionTotals.getSize());
+    report.add("edit history", this->history.getSize());
+
     return;
 }
@@ -1,10 +1,23 @@
 #ifndef CITY_HPP
 #define CITY_HPP
 
+#include <SFML/System.hpp>
 #include <vector>
 #include <map>
+#include <random>
+#include <functional>
+#include <cstdint>
 
 #include "map.hpp"
+#include "growth_kernel.hpp"
+#include "edit_history.hpp"
+#include "commute.hpp"
+#include "pathfinder.hpp"
+#include "field.hpp"
+#include "utilities.hpp"
+#include "statistics.hpp"
+#include "activity.hpp"
+#include "memory.hpp"
 
 class City
 {
@@ -13,7 +26,9 @@ class City
     float currentTime;
     float timePerDay;
 
-    std::vector<int> shuffledTiles;
+    /* Indices of the tiles of each zone, in the random order they are
+     * updated in. Indexed by Map::zoneIndex() */
+    std::vector<int> shuffledTiles[3];
 
     /* Number of residents who are not in a residential zone */
     double populationPool;
@@ -30,8 +45,92 @@ class City
     double birthRate;
     double deathRate;
 
+    /* Residents and capacities of the residential zones, packed in
+     * update order for the growth kernel */
+    std::vector<double> packedPopulation;
+    std::vector<double> packedCapacity;
+
+    /* Zones whose sleep timers fired today */
+    std::vector<int> firedTimers;
+
+    /* Tiles whose fields changed today, and transport regions whose
+     * power did */
+    Selection changedFields;
+    std::vector<unsigned int> changedRegions;
+
+    /* Zones of each type in each transport region, in update order.
+     * The zones of type z in region r start at regionStarts[z][r] and
+     * end at regionStarts[z][r+1]. Rebuilt when the regions or the
+     * order change */
+    std::vector<int> regionZones[3];
+    std::vector<unsigned int> regionStarts[3];
+    bool regionsDirty;
+
+    /* Industrial zones that may have resources to give, keyed by their
+     * transport region and position. Kept from day to day, with the
+     * zones that extract more added as they do, and sorted before use */
+    std::vector<std::uint64_t> producers;
+
+    /* Index of the first producer at or after each index that still
+     * has something to give, as a forest whose roots are the producers
+     * with something left. Exhausted producers point past themselves */
+    std::vector<int> nextProducer;
+
+    /* Industrial zones that may have goods to sell, kept from day to
+     * day like the producers */
+    std::vector<int> stocked;
+
+    /* Reaches of the commercial zones that trade today, in update
+     * order */
+    std::vector<Reach*> trading;
+
+    /* Revenue of every commercial zone, which is the sum over every
+     * household of its residents times its spending. Kept up to date as
+     * either changes */
+    double commercialRevenue;
+
+    /* Zones within commuting distance of each commercial zone */
+    CommuteCache commute;
+
+    /* Rebuild the zones of each region, the commuting reaches, and
+     * everything kept up to date from day to day rather than counted */
+    void indexRegions();
+
+    /* The population of the tile at pos has changed by delta. Updates
+     * the totals that depend on it */
+    void populationChanged(int pos, const Tile& tile, double delta);
+
+    /* Invalidate the commuting reach of every region touching the
+     * tiles at the given positions */
+    void invalidateCommute(const std::vector<int>& changed);
+
     double distributePool(double& pool, Tile& tile, double rate);
 
+    /* Multiplier on the chance of the zone at pos growing. Zones
+     * without power or water grow at half the rate */
+    float getDesirability(const Tile& tile, int pos) const;
+
+    /* Put the zone at pos to sleep if nothing will change it until it
+     * next levels up, and set a timer for when that will be */
+    void sleepIfSteady(int pos, const Tile& tile, float desirability);
+
+    /* Draw the timer of the zone at pos again if it is asleep, with its
+     * current desirability */
+    void rearm(int pos);
+
+    /* Put the tiles at the given positions into the update order of
+     * their new zones at random places, without reshuffling the rest */
+    void reshuffleTiles(const std::vector<int>& changed);
+
+    /* Move the residents or workers of a tile into the matching pool,
+     * or take up to population of them out of it */
+    void releasePopulation(const Tile& tile);
+    double takePopulation(TileType tileType, double population);
+
+    /* Replace the tiles of the edit's diffs with the tiles they hold,
+     * leaving the diffs holding the tiles they replaced */
+    void swapTiles(Edit& edit);
+
     public:
 
     Map map;
@@ -49,7 +148,43 @@ class City
 
     int day;
 
-    City()
+    /* update() advances speed days per second, unless paused */
+    bool paused;
+    float speed;
+
+    /* Random numbers for the simulation. Every city has its own, so
+     * cities run side by side on different threads give the same
+     * results as they would alone. Seed it before shuffleTiles */
+    std::mt19937 random;
+
+    /* Kernel used to distribute the population pool */
+    KernelMode growthKernel;
+
+    /* Tile placements that can be undone */
+    EditHistory history;
+
+    /* Routes along the roads */
+    Pathfinder pathfinder;
+
+    /* Pollution, land value and service coverage */
+    FieldSystem fields;
+
+    /* Power and water supply */
+    UtilityNetworks utilities;
+
+    /* History of the city, recorded at the end of every day */
+    StatsRecorder stats;
+
+    /* Zones and people in each transport region */
+    RegionTotals regionTotals;
+
+    /* Zones that are skipped by the daily update until they change */
+    ActivityTracker activity;
+
+    /* Tiles connected by each layer of regions, indexed by RegionType */
+    static const TileTypeSet regionTiles[numRegionTypes];
+
+    City() : pathfinder(TileType::ROAD)
     {
         this->birthRate = 0.00055;
         this->deathRate = 0.00023;
@@ -66,24 +201,58 @@ class City
         this->currentTime = 0.0;
         this->timePerDay = 1.0;
         this->day = 0;
+        this->paused = false;
+        this->speed = 1.0f;
+        this->growthKernel = KernelMode::EXACT;
+        this->regionsDirty = true;
+        this->commercialRevenue = 0;
     }
 
-    City(std::string cityName, int tileSize, std::map<std::string, Tile>& tileAtlas) : City()
+    City(std::string cityName, int tileSize, TileAtlas& tileAtlas) : City()
     {
         this->map.tileSize = tileSize;
         load(cityName, tileAtlas);
     }
 
-    void load(std::string cityName, std::map<std::string, Tile>& tileAtlas);
+    void load(std::string cityName, TileAtlas& tileAtlas);
     void save(std::string cityName);
 
-    void update(float dt);
-    void bulldoze(const Tile& tile);
+    /* Advance the game time, simulating a day once one has passed.
+     * betweenDays is called just before each day is simulated, and on
+     * every update while paused, so that changes to the city are only
+     * made between days */
+    void update(float dt, const std::function<void()>& betweenDays = nullptr);
+    /* Advance the simulation by exactly one day, independent of the
+     * game time */
+    void simulateDay();
+    /* Replace the tiles in the selection, adding their old state to edit */
+    void bulldoze(TileType tileType, const Selection& selection, Edit& edit);
     void shuffleTiles();
     void tileChanged();
+    /* Only recalculate what the tiles at the given positions affect */
+    void tileChanged(const std::vector<int>& changed);
+
+    /* Select the tiles between start and end that can be replaced by
+     * a tile of the given type */
+    void selectForPlacement(sf::Vector2i start, sf::Vector2i end, TileType tileType);
+
+    /* Replace the tiles between start and end that can be replaced with
+     * tiles of the prototype's type if the city can afford it, without
+     * touching the map's selection. Returns the amount charged, which is 0
+     * if nothing was placed */
+    unsigned int placeTiles(const TilePrototype& prototype, sf::Vector2i start, sf::Vector2i end);
+
+    /* Undo the last placement, refunding it, or place it again. Return
+     * false if there is nothing to undo or redo, or the redo cannot be
+     * afforded */
+    bool undo();
+    bool redo();
+
+    /* Add the memory used by each part of the city to the report */
+    void getMemory(MemoryReport& report) const;
 
-    double getHomeless() { return this->populationPool; }
-    double getUnemployed() { return this->employmentPool; }
+    double getHomeless() const { return this->populationPool; }
+    double getUnemployed() const { return this->employmentPool; }
 };
 
 #endif /* CITY_HPP */
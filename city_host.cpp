@@ -0,0 +1,53 @@
+#include <SFML/System.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "city_host.hpp"
+#include "city.hpp"
+#include "tile.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+
+HostedCity& CityHost::add(const std::string& name, int tileSize, TileAtlas& tileAtlas, unsigned int seed)
+{
+    HostedCity* hosted = new HostedCity(name, tileSize, tileAtlas);
+    hosted->city.random.seed(seed);
+    hosted->city.shuffleTiles();
+    this->cities.push_back(hosted);
+
+    return *hosted;
+}
+
+double CityHost::run(int days, ThreadPool& pool)
+{
+    sf::Clock clock;
+
+    for(int day = 0; day < days; day += this->daysPerRound)
+    {
+        int roundDays = std::min(this->daysPerRound, days - day);
+
+        /* Threads take one city at a time, so a slow city only holds
+         * up the thread running it */
+        pool.parallelFor(this->cities.size(), 1,
+            [&](unsigned int begin, unsigned int end, unsigned int thread)
+            {
+                for(unsigned int i = begin; i < end; ++i)
+                {
+                    HostedCity& hosted = *this->cities[i];
+                    TraceZone zone("CityHost::run");
+                    sf::Clock cityClock;
+                    for(int j = 0; j < roundDays; ++j) hosted.city.simulateDay();
+                    hosted.seconds += cityClock.getElapsedTime().asSeconds();
+                    hosted.days += roundDays;
+                }
+            });
+    }
+
+    return clock.getElapsedTime().asSeconds();
+}
+
+CityHost::~CityHost()
+{
+    for(auto hosted : this->cities) delete hosted;
+}
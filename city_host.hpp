@@ -0,0 +1,63 @@
+#ifndef CITY_HOST_HPP
+#define CITY_HOST_HPP
+
+#include <string>
+#include <vector>
+
+#include "city.hpp"
+
+class TileAtlas;
+class ThreadPool;
+
+/* A city run by a CityHost, and how long it has taken */
+class HostedCity
+{
+    public:
+
+    std::string name;
+    City city;
+
+    /* Days simulated, and the time spent simulating them */
+    int days;
+    double seconds;
+
+    HostedCity(const std::string& name, int tileSize, TileAtlas& tileAtlas) :
+        city(name, tileSize, tileAtlas)
+    {
+        this->name = name;
+        this->days = 0;
+        this->seconds = 0.0;
+    }
+};
+
+/* Runs many independent cities in one process. They share the tile
+ * atlas and the worker threads, and are advanced in rounds so that no
+ * city gets more than a round ahead of the rest */
+class CityHost
+{
+    private:
+
+    std::vector<HostedCity*> cities;
+
+    public:
+
+    /* Days each city advances by in a round. Longer rounds have less
+     * overhead but let the cities drift further apart */
+    int daysPerRound;
+
+    /* Load a city, sharing the tile atlas with the others, and seed
+     * its random numbers */
+    HostedCity& add(const std::string& name, int tileSize, TileAtlas& tileAtlas, unsigned int seed);
+
+    /* Advance every city by days, spreading the cities of each round
+     * across the pool's threads. Returns the wall clock time taken */
+    double run(int days, ThreadPool& pool);
+
+    unsigned int size() const { return this->cities.size(); }
+    const HostedCity& operator[](unsigned int i) const { return *this->cities[i]; }
+
+    CityHost() { this->daysPerRound = 30; }
+    ~CityHost();
+};
+
+#endif /* CITY_HOST_HPP */
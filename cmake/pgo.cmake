@@ -0,0 +1,75 @@
+# Profile guided build of citybuilder, run by the pgo target:
+#  1. Build an instrumented citybuilder_headless in BINARY_DIR
+#  2. Train it by generating a city, simulating it for TRAINING_DAYS and
+#     saving it, then loading, simulating and saving it again
+#  3. Rebuild citybuilder and citybuilder_headless with the profile
+#  4. Benchmark the BASELINE runner against the optimised one
+cmake_minimum_required(VERSION 3.0)
+
+function(run)
+	execute_process(COMMAND ${ARGN} WORKING_DIRECTORY ${BINARY_DIR} RESULT_VARIABLE result)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "Failed to run ${ARGN}")
+	endif()
+endfunction()
+
+# Thousandths of a day simulated per second, from a benchmark written by
+# --benchmark, since CMake can only do integer arithmetic
+function(read_speed file variable)
+	file(READ ${file} benchmark)
+	string(REGEX MATCH "\"daysPerSecond\": ([0-9]+)\\.?([0-9]*)" match "${benchmark}")
+	string(SUBSTRING "${CMAKE_MATCH_2}000" 0 3 fraction)
+	math(EXPR speed "${CMAKE_MATCH_1} * 1000 + ${fraction}")
+	set(${variable} ${speed} PARENT_SCOPE)
+endfunction()
+
+function(configure stage)
+	run(${CMAKE_COMMAND} -C ${INITIAL_CACHE} -DCITYBUILDER_PGO=${stage}
+		-DCITYBUILDER_PGO_PROFILE=${BINARY_DIR}/citybuilder.profdata ${SOURCE_DIR})
+endfunction()
+
+file(MAKE_DIRECTORY ${BINARY_DIR})
+set(HEADLESS ${BINARY_DIR}/citybuilder_headless)
+
+# Old profiles would be merged with the new ones
+file(GLOB_RECURSE old_profiles ${BINARY_DIR}/*.gcda ${BINARY_DIR}/profiles/*.profraw)
+if(old_profiles)
+	file(REMOVE ${old_profiles})
+endif()
+
+message(STATUS "Building the instrumented headless runner")
+configure(GENERATE)
+run(${CMAKE_COMMAND} --build ${BINARY_DIR} --target citybuilder_headless)
+
+message(STATUS "Training on a ${TRAINING_SIZE} city for ${TRAINING_DAYS} days")
+run(${HEADLESS} --generate pgo_city --size ${TRAINING_SIZE} --days ${TRAINING_DAYS} --save pgo_city)
+run(${HEADLESS} --city pgo_city --days 30 --paths 1000 --save pgo_city)
+
+if(COMPILER_ID MATCHES "Clang")
+	find_program(LLVM_PROFDATA NAMES llvm-profdata)
+	if(NOT LLVM_PROFDATA)
+		message(FATAL_ERROR "llvm-profdata is needed to merge Clang's profiles")
+	endif()
+	file(GLOB profiles ${BINARY_DIR}/profiles/*.profraw)
+	run(${LLVM_PROFDATA} merge -output=${BINARY_DIR}/citybuilder.profdata ${profiles})
+else()
+	# GCC looks for each object's profile beside it, so the game's
+	# objects need copies of the headless runner's
+	file(GLOB profiles ${BINARY_DIR}/CMakeFiles/citybuilder_headless.dir/*.gcda)
+	file(COPY ${profiles} DESTINATION ${BINARY_DIR}/CMakeFiles/citybuilder.dir)
+endif()
+
+message(STATUS "Building with the profile")
+configure(USE)
+run(${CMAKE_COMMAND} --build ${BINARY_DIR})
+
+# Both runners simulate the same saved city
+message(STATUS "Benchmarking")
+run(${BASELINE} --city pgo_city --days 360 --benchmark ${BINARY_DIR}/baseline.json)
+run(${HEADLESS} --city pgo_city --days 360 --benchmark ${BINARY_DIR}/pgo.json)
+read_speed(${BINARY_DIR}/baseline.json baseline)
+read_speed(${BINARY_DIR}/pgo.json optimised)
+math(EXPR percent "100 * ${optimised} / ${baseline} - 100")
+math(EXPR baseline "${baseline} / 1000")
+math(EXPR optimised "${optimised} / 1000")
+message(STATUS "Baseline ${baseline} days/s, PGO+LTO ${optimised} days/s (${percent}% faster)")
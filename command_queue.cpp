@@ -0,0 +1,32 @@
+#include "command_queue.hpp"
+#include "replay.hpp"
+#include "city.hpp"
+#include "tile.hpp"
+
+bool CommandQueue::submit(const Command& command)
+{
+    return this->commands.push(command);
+}
+
+void CommandQueue::apply(City& city, TileAtlas& tileAtlas, Recorder* recorder)
+{
+    Command command;
+    while(this->commands.pop(command))
+    {
+        /* The command happens on the day it is applied, which is the day
+         * a replay must apply it on too */
+        command.day = city.day;
+        if(recorder != nullptr) recorder->record(command);
+        unsigned int cost = command.execute(city, tileAtlas);
+
+        /* Results nobody polls for are dropped once the queue fills */
+        this->results.push(CommandResult(command, cost));
+    }
+
+    return;
+}
+
+bool CommandQueue::poll(CommandResult& result)
+{
+    return this->results.pop(result);
+}
@@ -0,0 +1,58 @@
+#ifndef COMMAND_QUEUE_HPP
+#define COMMAND_QUEUE_HPP
+
+#include "bounded_queue.hpp"
+#include "replay.hpp"
+#include "city.hpp"
+#include "tile.hpp"
+
+/* Outcome of a command, reported back once the simulation has applied it */
+class CommandResult
+{
+    public:
+
+    /* The command as applied, tagged with the day it was applied on */
+    Command command;
+
+    /* Amount charged */
+    unsigned int cost;
+
+    CommandResult()
+    {
+        this->cost = 0;
+    }
+    CommandResult(const Command& command, unsigned int cost)
+    {
+        this->command = command;
+        this->cost = cost;
+    }
+};
+
+/* Carries commands from input handling to the simulation, and their
+ * results back, without either side touching the other's state. Any
+ * thread may submit commands, but only the simulation applies them and
+ * only one thread polls the results */
+class CommandQueue
+{
+    private:
+
+    BoundedQueue<Command> commands;
+    BoundedQueue<CommandResult> results;
+
+    public:
+
+    /* Queue a command to be applied before the next day is simulated.
+     * Returns false if the queue is full and the command was dropped */
+    bool submit(const Command& command);
+
+    /* Apply every submitted command to the city, in the order they were
+     * submitted. Must only be called between days. Each command is
+     * recorded as it is applied if there is a recorder */
+    void apply(City& city, TileAtlas& tileAtlas, Recorder* recorder = nullptr);
+
+    /* Take the result of the oldest applied command. Returns false if
+     * there are none waiting */
+    bool poll(CommandResult& result);
+};
+
+#endif /* COMMAND_QUEUE_HPP */
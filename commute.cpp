@@ -0,0 +1,295 @@
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+
+#include "commute.hpp"
+#include "map.hpp"
+#include "tile.hpp"
+#include "memory.hpp"
+#include "selection.hpp"
+
+/* Width and height of the blocks commercial zones are searched from */
+const static unsigned int blockSize = 16;
+
+/* Index of the block containing the tile at pos */
+static unsigned int getBlock(const Map& map, int pos)
+{
+    unsigned int blocksPerRow = (map.width + blockSize - 1) / blockSize;
+
+    return (pos / map.width / blockSize) * blocksPerRow + (pos % map.width) / blockSize;
+}
+
+void CommuteCache::invalidate(unsigned int region)
+{
+    if(region >= this->dirtyRegions.size()) this->dirtyRegions.resize(region+1, false);
+    this->dirtyRegions[region] = true;
+
+    return;
+}
+
+void CommuteCache::invalidateAll()
+{
+    this->allDirty = true;
+
+    return;
+}
+
+void CommuteCache::distribute(const std::vector<Reached>& zones, Reach** batch, std::size_t count,
+    std::vector<int> Reach::* list)
+{
+    /* Count first, so that each list is allocated once */
+    unsigned int counts[batchSize] = { 0 };
+    for(auto& zone : zones)
+    {
+        for(std::uint64_t bits = zone.second; bits != 0; bits &= bits - 1)
+            ++counts[Selection::lowestBit(bits)];
+    }
+    for(std::size_t i = 0; i < count; ++i) (batch[i]->*list).reserve(counts[i]);
+    for(auto& zone : zones)
+    {
+        for(std::uint64_t bits = zone.second; bits != 0; bits &= bits - 1)
+            (batch[Selection::lowestBit(bits)]->*list).push_back(zone.first);
+    }
+
+    return;
+}
+
+void CommuteCache::addShops(const std::vector<Reached>& zones, Reach** batch)
+{
+    for(auto& zone : zones)
+    {
+        std::vector<Reach*>& shops = this->shops[zone.first];
+        shops.reserve(shops.size() + Selection::countBits(zone.second));
+        for(std::uint64_t bits = zone.second; bits != 0; bits &= bits - 1)
+            shops.push_back(batch[Selection::lowestBit(bits)]);
+    }
+
+    return;
+}
+
+int CommuteCache::addHousehold(int pos)
+{
+    if(this->householdIndices[pos] >= 0) return this->householdIndices[pos];
+
+    int household = this->households.size();
+    if(!this->freeHouseholds.empty())
+    {
+        household = this->freeHouseholds.back();
+        this->freeHouseholds.pop_back();
+    }
+    else
+    {
+        this->households.push_back(Household());
+    }
+    this->householdIndices[pos] = household;
+
+    return household;
+}
+
+void CommuteCache::search(const Map& map, const std::vector<int>& sources)
+{
+    const TileTypeSet travel =
+        TileType::ROAD          | TileType::RESIDENTIAL |
+        TileType::COMMERCIAL    | TileType::INDUSTRIAL;
+    int distance = this->distance;
+
+    for(std::size_t first = 0; first < sources.size(); first += batchSize)
+    {
+        std::size_t count = sources.size() - first;
+        if(count > batchSize) count = batchSize;
+        Reach* batch[batchSize];
+        int left = map.width, top = map.height, right = 0, bottom = 0;
+        this->frontier.clear();
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            int pos = sources[first+i];
+            batch[i] = &this->reaches[pos];
+            batch[i]->pos = pos;
+            /* Swapping frees the old lists, so each is sized exactly */
+            std::vector<int>().swap(batch[i]->residential);
+            std::vector<int>().swap(batch[i]->industrial);
+            std::uint64_t bit = std::uint64_t(1) << i;
+            this->seen[pos] |= bit;
+            this->frontier.push_back(std::make_pair(pos, bit));
+            left = std::min(left, int(pos % map.width));
+            right = std::max(right, int(pos % map.width));
+            top = std::min(top, int(pos / map.width));
+            bottom = std::max(bottom, int(pos / map.width));
+        }
+
+        /* Expand one ring of tiles at a time, stopping at the commuting
+         * distance. Other commercial zones are passed through, so every
+         * zone within distance is reached by every source */
+        std::size_t ringStart = 0;
+        for(int dist = 0; dist < distance && ringStart < this->frontier.size(); ++dist)
+        {
+            std::size_t ringEnd = this->frontier.size();
+            for(std::size_t i = ringStart; i < ringEnd; ++i)
+            {
+                int current = this->frontier[i].first;
+                std::uint64_t reaching = this->frontier[i].second;
+                int x = current % map.width;
+                int y = current / map.width;
+                int width = map.width;
+                int around[4] = {
+                    x > 0               ? current-1     : -1,
+                    y < map.height-1    ? current+width : -1,
+                    x < map.width-1     ? current+1     : -1,
+                    y > 0               ? current-width : -1 };
+
+                for(int next : around)
+                {
+                    if(next < 0) continue;
+                    if(!travel.contains(map.tiles[next].tileType)) continue;
+                    std::uint64_t reached = reaching & ~this->seen[next];
+                    if(reached == 0) continue;
+
+                    this->seen[next] |= reached;
+                    this->frontier.push_back(std::make_pair(next, reached));
+                }
+            }
+            ringStart = ringEnd;
+        }
+
+        /* Every tile reached is within distance of a source, so scanning
+         * around the sources in map order finds each zone once, with all
+         * of the sources that reached it, and clears the masks. Zones are
+         * visited in map order, as they were when every zone in the
+         * region was in reach */
+        left = std::max(left - distance, 0);
+        right = std::min(right + distance, int(map.width)-1);
+        top = std::max(top - distance, 0);
+        bottom = std::min(bottom + distance, int(map.height)-1);
+        this->residential.clear();
+        this->industrial.clear();
+        for(int y = top; y <= bottom; ++y)
+        {
+            for(int x = left; x <= right; ++x)
+            {
+                int pos = y*map.width+x;
+                std::uint64_t reached = this->seen[pos];
+                if(reached == 0) continue;
+                this->seen[pos] = 0;
+                TileType tileType = map.tiles[pos].tileType;
+                if(tileType == TileType::RESIDENTIAL)       this->residential.push_back(std::make_pair(pos, reached));
+                else if(tileType == TileType::INDUSTRIAL)   this->industrial.push_back(std::make_pair(pos, reached));
+            }
+        }
+        this->addShops(this->industrial, batch);
+        for(auto& zone : this->residential) zone.first = this->addHousehold(zone.first);
+        this->distribute(this->residential, batch, count, &Reach::residential);
+        this->distribute(this->industrial, batch, count, &Reach::industrial);
+    }
+
+    return;
+}
+
+void CommuteCache::refresh(const Map& map)
+{
+    const std::vector<int>& commercial = map.zoneTiles[Map::zoneIndex(TileType::COMMERCIAL)];
+
+    if(this->seen.size() != map.tiles.size())
+    {
+        this->seen.assign(map.tiles.size(), 0);
+        this->householdIndices.assign(map.tiles.size(), -1);
+        this->households.clear();
+        this->freeHouseholds.clear();
+        this->allDirty = true;
+    }
+
+    auto isDirty = [this](unsigned int region)
+    {
+        return this->allDirty || (region < this->dirtyRegions.size() && this->dirtyRegions[region]);
+    };
+
+    /* Reaches do not depend on each other, so only new zones and those
+     * in out of date regions are searched from */
+    std::vector<int> sources;
+    for(int pos : commercial)
+    {
+        if(isDirty(map.tiles[pos].regions[0]) || this->reaches.find(pos) == this->reaches.end())
+            sources.push_back(pos);
+    }
+
+    /* Industrial zones in out of date regions can only be reached from
+     * them */
+    for(int pos : map.zoneTiles[Map::zoneIndex(TileType::INDUSTRIAL)])
+    {
+        if(isDirty(map.tiles[pos].regions[0])) this->shops[pos].clear();
+    }
+
+    /* Batches of nearby zones share most of the tiles they reach, so
+     * search from blocks of the map at a time rather than rows */
+    std::stable_sort(sources.begin(), sources.end(), [&map](int a, int b)
+    {
+        return getBlock(map, a) < getBlock(map, b);
+    });
+
+    if(!sources.empty()) this->search(map, sources);
+
+    /* Forget zones that have been replaced */
+    if(this->reaches.size() != commercial.size())
+    {
+        for(auto it = this->reaches.begin(); it != this->reaches.end();)
+        {
+            if(map.tiles[it->first].tileType != TileType::COMMERCIAL)
+                it = this->reaches.erase(it);
+            else
+                ++it;
+        }
+    }
+    if(this->shops.size() > map.zoneTiles[Map::zoneIndex(TileType::INDUSTRIAL)].size())
+    {
+        for(auto it = this->shops.begin(); it != this->shops.end();)
+        {
+            if(map.tiles[it->first].tileType != TileType::INDUSTRIAL)
+                it = this->shops.erase(it);
+            else
+                ++it;
+        }
+    }
+    if(this->households.size() - this->freeHouseholds.size() >
+        map.zoneTiles[Map::zoneIndex(TileType::RESIDENTIAL)].size())
+    {
+        for(unsigned int pos = 0; pos < map.tiles.size(); ++pos)
+        {
+            int household = this->householdIndices[pos];
+            if(household < 0 || map.tiles[pos].tileType == TileType::RESIDENTIAL) continue;
+            this->households[household] = Household();
+            this->freeHouseholds.push_back(household);
+            this->householdIndices[pos] = -1;
+        }
+    }
+
+    this->dirtyRegions.assign(this->dirtyRegions.size(), false);
+    this->allDirty = false;
+
+    return;
+}
+
+const std::vector<Reach*>& CommuteCache::getShops(int pos) const
+{
+    const static std::vector<Reach*> none;
+    auto it = this->shops.find(pos);
+
+    return it != this->shops.end() ? it->second : none;
+}
+
+std::size_t CommuteCache::getSize() const
+{
+    /* Each entry of the map is a node holding the next pointer and the
+     * entry, and each bucket is a pointer */
+    std::size_t size = this->reaches.bucket_count() * sizeof(void*) +
+        this->reaches.size() * (sizeof(void*) + sizeof(std::pair<const int, Reach>));
+    for(auto& reach : this->reaches)
+        size += vectorSize(reach.second.residential) + vectorSize(reach.second.industrial);
+    size += this->shops.bucket_count() * sizeof(void*) +
+        this->shops.size() * (sizeof(void*) + sizeof(std::pair<const int, std::vector<Reach*>>));
+    for(auto& shops : this->shops) size += vectorSize(shops.second);
+    size += vectorSize(this->householdIndices) + vectorSize(this->freeHouseholds) +
+        vectorSize(this->households);
+
+    return size + vectorSize(this->dirtyRegions) + vectorSize(this->seen) + vectorSize(this->frontier) +
+        vectorSize(this->residential) + vectorSize(this->industrial);
+}
@@ -0,0 +1,161 @@
+#ifndef COMMUTE_HPP
+#define COMMUTE_HPP
+
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+class Map;
+
+/* Zones a commercial zone draws customers and goods from */
+class Reach
+{
+    public:
+
+    /* Position of the commercial zone */
+    int pos;
+
+    /* Households of the residential zones, and the industrial zones,
+     * both in map order */
+    std::vector<int> residential;
+    std::vector<int> industrial;
+
+    /* Revenue the zone makes from each customer. Kept by the city */
+    double perCustomer;
+
+    /* Last day the zone was chosen to trade on */
+    int tradeDay;
+
+    Reach()
+    {
+        this->pos = -1;
+        this->perCustomer = 0;
+        this->tradeDay = -1;
+    }
+};
+
+/* Residents of a residential zone, and the revenue each of them makes
+ * for the commercial zones within reach. Kept by the city */
+class Household
+{
+    public:
+
+    double residents;
+    double spending;
+
+    Household()
+    {
+        this->residents = 0;
+        this->spending = 0;
+    }
+};
+
+/* Caches which residential and industrial zones are within commuting
+ * distance of each commercial zone, and which commercial zones are in
+ * reach of each industrial zone. A zone can be in reach of several
+ * commercial zones, and is counted by each of them. Every residential
+ * zone in reach of any has a household, so that values the city keeps
+ * for it are packed together. Distances are
+ * measured through the same tiles that connect regions, so only change
+ * when the regions do. The reaches of every region that has been
+ * invalidated are found together by a single breadth first search from
+ * all of their commercial zones, the next time they are needed */
+class CommuteCache
+{
+    private:
+
+    /* Commercial zones searched from at once, one per bit of a mask */
+    const static unsigned int batchSize = 64;
+
+    std::unordered_map<int, Reach> reaches;
+
+    /* Reaches of the commercial zones in reach of each industrial zone.
+     * Elements of an unordered_map keep their address, and a reach is
+     * only removed along with every zone that refers to it, since they
+     * are all in the same region */
+    std::unordered_map<int, std::vector<Reach*>> shops;
+
+    /* Household of the zone at each position, -1 for none, and
+     * households that have been freed for reuse */
+    std::vector<int> householdIndices;
+    std::vector<int> freeHouseholds;
+
+    /* Regions whose reaches are out of date, indexed by region label */
+    std::vector<bool> dirtyRegions;
+    bool allDirty;
+
+    /* A tile and the commercial zones of a batch that reached it */
+    typedef std::pair<int, std::uint64_t> Reached;
+
+    /* Breadth first search state, reused between searches. Bit i of a
+     * tile's mask is set once the i-th commercial zone of the batch has
+     * reached it, and each tile in the frontier is paired with the zones
+     * that first reached it in its ring. Masks are cleared after each
+     * batch */
+    std::vector<std::uint64_t> seen;
+    std::vector<Reached> frontier;
+
+    /* Residential and industrial zones reached by the batch */
+    std::vector<Reached> residential;
+    std::vector<Reached> industrial;
+
+    /* Search outwards from every commercial zone at once, a batch at a
+     * time, adding each zone reached to the reach of every commercial
+     * zone that reached it */
+    void search(const Map& map, const std::vector<int>& sources);
+
+    /* Add the zones reached by a batch to the given list of the reach
+     * of each source that reached them, in order */
+    void distribute(const std::vector<Reached>& zones, Reach** batch, std::size_t count,
+        std::vector<int> Reach::* list);
+
+    /* Add the sources of a batch to the shops of each zone they reached */
+    void addShops(const std::vector<Reached>& zones, Reach** batch);
+
+    /* Household of the residential zone at pos, giving it one if it has
+     * none */
+    int addHousehold(int pos);
+
+    public:
+
+    /* Furthest distance, in tiles, that anyone will travel */
+    unsigned int distance;
+
+    /* Indexed by Reach::residential. Households that are not in use
+     * are left empty */
+    std::vector<Household> households;
+
+    /* Mark the reaches in the region as out of date */
+    void invalidate(unsigned int region);
+    void invalidateAll();
+
+    /* Recalculate any out of date reaches */
+    void refresh(const Map& map);
+
+    /* Zones within commuting distance of the commercial zone at pos.
+     * Only valid after refresh */
+    const Reach& getReach(int pos) const { return this->reaches.at(pos); }
+
+    Reach& getReach(int pos) { return this->reaches.at(pos); }
+
+    /* Reaches of the commercial zones within commuting distance of the
+     * industrial zone at pos. Only valid after refresh */
+    const std::vector<Reach*>& getShops(int pos) const;
+
+    /* Household of the residential zone at pos, or -1 if no commercial
+     * zone has reached it. Only valid after refresh */
+    int getHousehold(int pos) const { return this->householdIndices[pos]; }
+
+    /* Memory used, in bytes */
+    std::size_t getSize() const;
+
+    CommuteCache()
+    {
+        this->allDirty = true;
+        this->distance = 20;
+    }
+};
+
+#endif /* COMMUTE_HPP */
@@ -0,0 +1,80 @@
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "edit_history.hpp"
+
+void EditHistory::trim()
+{
+    /* Edits that could be redone are further from the present than
+     * any that could be undone, so are forgotten first */
+    while(this->size > this->budget && !this->redoStack.empty())
+    {
+        this->size -= this->redoStack.front().getSize();
+        this->redoStack.pop_front();
+    }
+    /* Always keep the latest edit, however large */
+    while(this->size > this->budget && this->undoStack.size() > 1)
+    {
+        this->size -= this->undoStack.front().getSize();
+        this->undoStack.pop_front();
+    }
+
+    return;
+}
+
+void EditHistory::push(Edit&& edit)
+{
+    for(auto& redo : this->redoStack) this->size -= redo.getSize();
+    this->redoStack.clear();
+
+    this->pushUndo(std::move(edit));
+
+    return;
+}
+
+Edit EditHistory::popUndo()
+{
+    Edit edit = std::move(this->undoStack.back());
+    this->undoStack.pop_back();
+    this->size -= edit.getSize();
+
+    return edit;
+}
+
+Edit EditHistory::popRedo()
+{
+    Edit edit = std::move(this->redoStack.back());
+    this->redoStack.pop_back();
+    this->size -= edit.getSize();
+
+    return edit;
+}
+
+void EditHistory::pushUndo(Edit&& edit)
+{
+    edit.diffs.shrink_to_fit();
+    this->size += edit.getSize();
+    this->undoStack.push_back(std::move(edit));
+    this->trim();
+
+    return;
+}
+
+void EditHistory::pushRedo(Edit&& edit)
+{
+    this->size += edit.getSize();
+    this->redoStack.push_back(std::move(edit));
+    this->trim();
+
+    return;
+}
+
+void EditHistory::clear()
+{
+    this->undoStack.clear();
+    this->redoStack.clear();
+    this->size = 0;
+
+    return;
+}
@@ -0,0 +1,115 @@
+#ifndef EDIT_HISTORY_HPP
+#define EDIT_HISTORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "tile.hpp"
+
+/* A tile as it was before an edit replaced it. Only what the player can
+ * lose is kept, everything else is recalculated when it is restored.
+ * Undoing an edit swaps the diffs with the tiles they replaced, so the
+ * same diffs then hold what redoing it restores */
+class TileDiff
+{
+    public:
+
+    int pos;
+    std::uint8_t tileType;
+    std::uint8_t tileVariant;
+    float production;
+    float storedGoods;
+    double population;
+
+    /* People the edit moved from the tile into its pool, which are
+     * taken back out when the tile is restored */
+    double poolDelta;
+
+    TileDiff(int pos, const Tile& tile, double poolDelta)
+    {
+        this->pos = pos;
+        this->tileType = std::uint8_t(tile.tileType);
+        this->tileVariant = std::uint8_t(tile.tileVariant);
+        this->production = tile.production;
+        this->storedGoods = tile.storedGoods;
+        this->population = tile.population;
+        this->poolDelta = poolDelta;
+    }
+};
+
+/* A single placement of tiles, holding only the tiles it changed */
+class Edit
+{
+    public:
+
+    /* Type of the tiles placed */
+    TileType tileType;
+
+    /* Amount charged for the placement */
+    unsigned int cost;
+
+    std::vector<TileDiff> diffs;
+
+    /* Memory used by the edit */
+    std::size_t getSize() const
+    {
+        return sizeof(Edit) + this->diffs.capacity() * sizeof(TileDiff);
+    }
+
+    Edit(TileType tileType, unsigned int cost)
+    {
+        this->tileType = tileType;
+        this->cost = cost;
+    }
+};
+
+/* Undo and redo stacks of edits. The oldest edits are forgotten once the
+ * stacks use more memory than the budget */
+class EditHistory
+{
+    private:
+
+    std::deque<Edit> undoStack;
+    std::deque<Edit> redoStack;
+
+    /* Memory used by both stacks */
+    std::size_t size;
+
+    /* Forget the oldest edits until the stacks fit in the budget */
+    void trim();
+
+    public:
+
+    /* Maximum memory used by both stacks, in bytes */
+    std::size_t budget;
+
+    /* Record a new edit, which can no longer be redone after anything
+     * that was undone */
+    void push(Edit&& edit);
+
+    /* Move the last edit between the stacks */
+    Edit popUndo();
+    Edit popRedo();
+    void pushUndo(Edit&& edit);
+    void pushRedo(Edit&& edit);
+
+    bool canUndo() const { return !this->undoStack.empty(); }
+    bool canRedo() const { return !this->redoStack.empty(); }
+
+    /* Next edit that would be redone */
+    const Edit& nextRedo() const { return this->redoStack.back(); }
+
+    std::size_t getSize() const { return this->size; }
+
+    void clear();
+
+    EditHistory()
+    {
+        this->size = 0;
+        this->budget = 1 << 20;
+    }
+};
+
+#endif /* EDIT_HISTORY_HPP */
@@ -0,0 +1,396 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "field.hpp"
+#include "map.hpp"
+#include "tile.hpp"
+#include "simd.hpp"
+#include "selection.hpp"
+#include "memory.hpp"
+
+float Field::sample(int x, int y) const
+{
+    if(this->values.empty()) return 0.0f;
+
+    /* Cell centres are half a cell in from their corners */
+    float fx = (x + 0.5f) / this->scale - 0.5f;
+    float fy = (y + 0.5f) / this->scale - 0.5f;
+    fx = std::min(std::max(fx, 0.0f), float(this->width-1));
+    fy = std::min(std::max(fy, 0.0f), float(this->height-1));
+
+    unsigned int x0 = fx;
+    unsigned int y0 = fy;
+    unsigned int x1 = std::min(x0+1, this->width-1);
+    unsigned int y1 = std::min(y0+1, this->height-1);
+    float tx = fx - x0;
+    float ty = fy - y0;
+
+    float top = this->values[y0*this->width+x0] * (1-tx) + this->values[y0*this->width+x1] * tx;
+    float bottom = this->values[y1*this->width+x0] * (1-tx) + this->values[y1*this->width+x1] * tx;
+
+    return top * (1-ty) + bottom * ty;
+}
+
+/* out[x] is the sum of weights[k] * in[x+k], so in must be taps-1
+ * longer than out */
+static void convolveScalar(const float* in, const float* weights, unsigned int taps,
+    float* out, unsigned int n)
+{
+    for(unsigned int x = 0; x < n; ++x)
+    {
+        float sum = 0.0f;
+        for(unsigned int k = 0; k < taps; ++k) sum += weights[k] * in[x+k];
+        out[x] = sum;
+    }
+
+    return;
+}
+
+/* out[x] is the sum of weights[k] * rows[k][x], for x from begin to n */
+static void accumulateScalar(const float* const* rows, const float* weights, unsigned int taps,
+    float* out, unsigned int n, unsigned int begin = 0)
+{
+    for(unsigned int x = begin; x < n; ++x)
+    {
+        float sum = 0.0f;
+        for(unsigned int k = 0; k < taps; ++k) sum += weights[k] * rows[k][x];
+        out[x] = sum;
+    }
+
+    return;
+}
+
+#ifdef CITYBUILDER_SSE2
+static void convolveSSE2(const float* in, const float* weights, unsigned int taps,
+    float* out, unsigned int n)
+{
+    unsigned int x = 0;
+    for(; x + 4 <= n; x += 4)
+    {
+        __m128 sum = _mm_setzero_ps();
+        for(unsigned int k = 0; k < taps; ++k)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(in+x+k)));
+        _mm_storeu_ps(out+x, sum);
+    }
+    convolveScalar(in+x, weights, taps, out+x, n-x);
+
+    return;
+}
+
+static void accumulateSSE2(const float* const* rows, const float* weights, unsigned int taps,
+    float* out, unsigned int n)
+{
+    unsigned int x = 0;
+    for(; x + 4 <= n; x += 4)
+    {
+        __m128 sum = _mm_setzero_ps();
+        for(unsigned int k = 0; k < taps; ++k)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k]+x)));
+        _mm_storeu_ps(out+x, sum);
+    }
+    accumulateScalar(rows, weights, taps, out, n, x);
+
+    return;
+}
+#endif
+
+#ifdef CITYBUILDER_AVX2
+CITYBUILDER_TARGET_AVX2
+static void convolveAVX2(const float* in, const float* weights, unsigned int taps,
+    float* out, unsigned int n)
+{
+    unsigned int x = 0;
+    for(; x + 8 <= n; x += 8)
+    {
+        __m256 sum = _mm256_setzero_ps();
+        for(unsigned int k = 0; k < taps; ++k)
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(in+x+k)));
+        _mm256_storeu_ps(out+x, sum);
+    }
+    convolveScalar(in+x, weights, taps, out+x, n-x);
+
+    return;
+}
+
+CITYBUILDER_TARGET_AVX2
+static void accumulateAVX2(const float* const* rows, const float* weights, unsigned int taps,
+    float* out, unsigned int n)
+{
+    unsigned int x = 0;
+    for(; x + 8 <= n; x += 8)
+    {
+        __m256 sum = _mm256_setzero_ps();
+        for(unsigned int k = 0; k < taps; ++k)
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k]+x)));
+        _mm256_storeu_ps(out+x, sum);
+    }
+    accumulateScalar(rows, weights, taps, out, n, x);
+
+    return;
+}
+#endif
+
+static void convolve(const float* in, const float* weights, unsigned int taps,
+    float* out, unsigned int n)
+{
+#if defined(CITYBUILDER_AVX2)
+    if(hasAVX2()) convolveAVX2(in, weights, taps, out, n);
+    else convolveSSE2(in, weights, taps, out, n);
+#elif defined(CITYBUILDER_SSE2)
+    convolveSSE2(in, weights, taps, out, n);
+#else
+    convolveScalar(in, weights, taps, out, n);
+#endif
+
+    return;
+}
+
+static void accumulate(const float* const* rows, const float* weights, unsigned int taps,
+    float* out, unsigned int n)
+{
+#if defined(CITYBUILDER_AVX2)
+    if(hasAVX2()) accumulateAVX2(rows, weights, taps, out, n);
+    else accumulateSSE2(rows, weights, taps, out, n);
+#elif defined(CITYBUILDER_SSE2)
+    accumulateSSE2(rows, weights, taps, out, n);
+#else
+    accumulateScalar(rows, weights, taps, out, n);
+#endif
+
+    return;
+}
+
+FieldSystem::Layer::Layer(FieldType type, unsigned int scale, unsigned int radius)
+{
+    this->type = type;
+    this->field.scale = scale;
+    this->stage = Stage::STAMP;
+    this->row = 0;
+
+    /* Binomial weights approximate a Gaussian */
+    unsigned int taps = 2*radius+1;
+    this->weights.assign(taps, 0.0f);
+    this->weights[0] = 1.0f;
+    for(unsigned int i = 1; i < taps; ++i)
+    {
+        for(unsigned int k = i; k > 0; --k) this->weights[k] += this->weights[k-1];
+    }
+    float total = std::pow(2.0f, float(taps-1));
+    for(auto& weight : this->weights) weight /= total;
+}
+
+FieldSystem::FieldSystem()
+{
+    this->daysPerUpdate = 4;
+
+    /* Pollution stays local, services reach across the map */
+    this->layers.push_back(Layer(FieldType::POLLUTION, 1, 3));
+    this->layers.push_back(Layer(FieldType::LAND_VALUE, 2, 3));
+    this->layers.push_back(Layer(FieldType::SERVICES, 4, 2));
+}
+
+float FieldSystem::getSource(const Map& map, FieldType type, int pos) const
+{
+    const Tile& tile = map.tiles[pos];
+
+    switch(type)
+    {
+        case FieldType::POLLUTION:
+        {
+            if(tile.tileType == TileType::INDUSTRIAL)   return tile.tileVariant+1;
+            if(tile.tileType == TileType::ROAD)         return 0.1f;
+            return 0.0f;
+        }
+        case FieldType::LAND_VALUE:
+        {
+            /* Nature raises the value of the land and pollution lowers it */
+            float value = -2.0f * this->get(FieldType::POLLUTION).sample(pos % map.width, pos / map.width);
+            if(tile.tileType == TileType::WATER)        value += 1.0f;
+            else if(tile.tileType == TileType::FOREST)  value += 0.5f;
+            return value;
+        }
+        case FieldType::SERVICES:
+        {
+            if(tile.tileType == TileType::COMMERCIAL)   return tile.tileVariant+1;
+            return 0.0f;
+        }
+    }
+
+    return 0.0f;
+}
+
+unsigned int FieldSystem::step(const Map& map, Layer& layer, unsigned int rows, Selection* changed)
+{
+    Field& field = layer.field;
+    unsigned int scale = field.scale;
+    unsigned int width = (map.width + scale - 1) / scale;
+    unsigned int height = (map.height + scale - 1) / scale;
+
+    /* Start again if the map has changed size */
+    if(field.width != width || field.height != height)
+    {
+        field.width = width;
+        field.height = height;
+        field.values.assign(width*height, 0.0f);
+        layer.sources.assign(width*height, 0.0f);
+        layer.blurred.assign(width*height, 0.0f);
+        layer.next.assign(width*height, 0.0f);
+        layer.stage = Stage::STAMP;
+        layer.row = 0;
+    }
+
+    unsigned int taps = layer.weights.size();
+    int radius = taps / 2;
+    std::vector<float> padded(width + taps - 1);
+    std::vector<const float*> window(taps);
+
+    for(; rows > 0; --rows)
+    {
+        unsigned int y = layer.row;
+        switch(layer.stage)
+        {
+            case Stage::STAMP:
+            {
+                /* Average the sources of the tiles each cell covers */
+                for(unsigned int x = 0; x < width; ++x)
+                {
+                    float sum = 0.0f;
+                    for(unsigned int ty = y*scale; ty < std::min((y+1)*scale, map.height); ++ty)
+                    {
+                        for(unsigned int tx = x*scale; tx < std::min((x+1)*scale, map.width); ++tx)
+                        {
+                            sum += this->getSource(map, layer.type, ty*map.width+tx);
+                        }
+                    }
+                    layer.sources[y*width+x] = sum / (scale*scale);
+                }
+                break;
+            }
+            case Stage::BLUR_ROWS:
+            {
+                /* Repeat the edge cells past the edge of the map */
+                const float* row = &layer.sources[y*width];
+                for(int x = 0; x < int(padded.size()); ++x)
+                {
+                    padded[x] = row[std::min(std::max(x - radius, 0), int(width)-1)];
+                }
+                convolve(padded.data(), layer.weights.data(), taps, &layer.blurred[y*width], width);
+                break;
+            }
+            case Stage::BLUR_COLUMNS:
+            {
+                for(int k = 0; k < int(taps); ++k)
+                {
+                    int source = std::min(std::max(int(y) + k - radius, 0), int(height)-1);
+                    window[k] = &layer.blurred[source*width];
+                }
+                accumulate(window.data(), layer.weights.data(), taps, &layer.next[y*width], width);
+                break;
+            }
+        }
+
+        if(++layer.row < height) continue;
+        layer.row = 0;
+        if(layer.stage == Stage::STAMP)
+        {
+            layer.stage = Stage::BLUR_ROWS;
+        }
+        else if(layer.stage == Stage::BLUR_ROWS)
+        {
+            layer.stage = Stage::BLUR_COLUMNS;
+        }
+        else
+        {
+            /* Every row is done, so the new field can replace the old */
+            field.values.swap(layer.next);
+            if(changed != nullptr) this->markChanges(map, layer, *changed);
+            layer.stage = Stage::STAMP;
+            return rows-1;
+        }
+    }
+
+    return 0;
+}
+
+void FieldSystem::markChanges(const Map& map, const Layer& layer, Selection& changed) const
+{
+    const Field& field = layer.field;
+    int scale = field.scale;
+
+    for(int y = 0; y < int(field.height); ++y)
+    {
+        for(int x = 0; x < int(field.width); ++x)
+        {
+            if(field.values[y*field.width+x] == layer.next[y*field.width+x]) continue;
+
+            /* Tiles sample the cells on either side of them */
+            for(int ty = std::max((y-1)*scale, 0); ty < std::min((y+2)*scale, int(map.height)); ++ty)
+            {
+                for(int tx = std::max((x-1)*scale, 0); tx < std::min((x+2)*scale, int(map.width)); ++tx)
+                    changed.mark(tx, ty, true);
+            }
+        }
+    }
+
+    return;
+}
+
+void FieldSystem::update(const Map& map, Selection& changed)
+{
+    for(auto& layer : this->layers)
+    {
+        unsigned int height = (map.height + layer.field.scale - 1) / layer.field.scale;
+        unsigned int rows = (3*height + this->daysPerUpdate - 1) / this->daysPerUpdate;
+        this->step(map, layer, rows, &changed);
+    }
+
+    return;
+}
+
+void FieldSystem::rebuild(const Map& map)
+{
+    for(auto& layer : this->layers)
+    {
+        layer.stage = Stage::STAMP;
+        layer.row = 0;
+        unsigned int height = (map.height + layer.field.scale - 1) / layer.field.scale;
+        this->step(map, layer, 3*height);
+    }
+
+    return;
+}
+
+float FieldSystem::getDesirability(TileType tileType, int x, int y) const
+{
+    float desirability = 1.0f;
+    float pollution = this->get(FieldType::POLLUTION).sample(x, y);
+    float landValue = this->get(FieldType::LAND_VALUE).sample(x, y);
+    float services = this->get(FieldType::SERVICES).sample(x, y);
+
+    switch(tileType)
+    {
+        case TileType::RESIDENTIAL:
+            desirability += landValue + 0.5f * services - 2.0f * pollution;
+            break;
+        case TileType::COMMERCIAL:
+            desirability += landValue - pollution;
+            break;
+        default:
+            break;
+    }
+
+    return std::min(std::max(desirability, 0.25f), 2.0f);
+}
+
+std::size_t FieldSystem::getSize() const
+{
+    std::size_t size = vectorSize(this->layers);
+    for(auto& layer : this->layers)
+    {
+        size += vectorSize(layer.field.values) + vectorSize(layer.sources) +
+            vectorSize(layer.blurred) + vectorSize(layer.next) + vectorSize(layer.weights);
+    }
+
+    return size;
+}
@@ -0,0 +1,110 @@
+#ifndef FIELD_HPP
+#define FIELD_HPP
+
+#include <vector>
+#include <cstddef>
+
+#include "tile.hpp"
+
+class Map;
+class Selection;
+
+enum class FieldType { POLLUTION, LAND_VALUE, SERVICES };
+
+/* A value for every tile of the map, stored at a lower resolution for
+ * effects that spread a long way */
+class Field
+{
+    public:
+
+    /* Size of the grid of cells */
+    unsigned int width;
+    unsigned int height;
+
+    /* Width and height of a cell, in tiles */
+    unsigned int scale;
+
+    std::vector<float> values;
+
+    /* Value at a tile, interpolated between the nearest cells */
+    float sample(int x, int y) const;
+
+    Field()
+    {
+        this->width = 0;
+        this->height = 0;
+        this->scale = 1;
+    }
+};
+
+/* Keeps the scalar fields of the map up to date. Each field is made by
+ * stamping its sources into a grid and then blurring it, and is rebuilt
+ * a few rows at a time over several days so that no single day pays
+ * for all of it. The finished field replaces the old one once every row
+ * has been redone */
+class FieldSystem
+{
+    private:
+
+    enum class Stage { STAMP, BLUR_ROWS, BLUR_COLUMNS };
+
+    class Layer
+    {
+        public:
+
+        FieldType type;
+
+        /* Field that is read, and the one being rebuilt */
+        Field field;
+        std::vector<float> sources;
+        std::vector<float> blurred;
+        std::vector<float> next;
+
+        /* Normalised blur kernel, 2*radius+1 long */
+        std::vector<float> weights;
+
+        Stage stage;
+        unsigned int row;
+
+        Layer(FieldType type, unsigned int scale, unsigned int radius);
+    };
+
+    std::vector<Layer> layers;
+
+    /* Strength of the field's source at a tile */
+    float getSource(const Map& map, FieldType type, int pos) const;
+
+    /* Advance the rebuild of a layer by up to rows rows, returning how
+     * many rows of work were left over. If changed is given, marks the
+     * tiles affected by the new field once it replaces the old one */
+    unsigned int step(const Map& map, Layer& layer, unsigned int rows, Selection* changed = nullptr);
+
+    /* Mark the tiles that sample a cell whose value differs from the
+     * one it replaced, which is left in next */
+    void markChanges(const Map& map, const Layer& layer, Selection& changed) const;
+
+    public:
+
+    /* Days taken to rebuild every field */
+    unsigned int daysPerUpdate;
+
+    /* Rebuild part of every field, marking the tiles whose samples of
+     * a field differ once it has been replaced */
+    void update(const Map& map, Selection& changed);
+
+    /* Rebuild every field in one go */
+    void rebuild(const Map& map);
+
+    /* Memory used, in bytes */
+    std::size_t getSize() const;
+
+    const Field& get(FieldType type) const { return this->layers[int(type)].field; }
+
+    /* Multiplier on the chance of a zone at pos growing, from its
+     * pollution, land value and service coverage */
+    float getDesirability(TileType tileType, int x, int y) const;
+
+    FieldSystem();
+};
+
+#endif /* FIELD_HPP */
@@ -1,4 +1,8 @@
 #include <stack>
+#include <vector>
+#include <string>
+#include <utility>
+#include <iostream>
 
 #include <SFML/Graphics.hpp>
 #include <SFML/System.hpp>
@@ -8,60 +12,71 @@
 #include "texture_manager.hpp"
 #include "animation_handler.hpp"
 #include "tile.hpp"
+#include "trace.hpp"
 
 void Game::loadTiles()
 {
     Animation staticAnim(0, 0, 1.0f);
-    this->tileAtlas["grass"] =
-        Tile(this->tileSize, 1, texmgr.getRef("grass"),
+    this->tileAtlas.add("grass",
+        TilePrototype(this->tileSize, 1, texmgr.getHandle("grass"),
             { staticAnim },
-            TileType::GRASS, 50, 0, 1);
-    tileAtlas["forest"] =
-        Tile(this->tileSize, 1, texmgr.getRef("forest"),
+            TileType::GRASS, 50, 0, 1));
+    this->tileAtlas.add("forest",
+        TilePrototype(this->tileSize, 1, texmgr.getHandle("forest"),
             { staticAnim },
-            TileType::FOREST, 100, 0, 1);    
-    tileAtlas["water"] =
-        Tile(this->tileSize, 1, texmgr.getRef("water"),
+            TileType::FOREST, 100, 0, 1));    
+    this->tileAtlas.add("water",
+        TilePrototype(this->tileSize, 1, texmgr.getHandle("water"),
             { Animation(0, 3, 0.5f),
             Animation(0, 3, 0.5f),
             Animation(0, 3, 0.5f) },
-            TileType::WATER, 0, 0, 1);
-    tileAtlas["residential"] =
-        Tile(this->tileSize, 2, texmgr.getRef("residential"),
+            TileType::WATER, 0, 0, 1));
+    this->tileAtlas.add("residential",
+        TilePrototype(this->tileSize, 2, texmgr.getHandle("residential"),
             { staticAnim, staticAnim, staticAnim,
             staticAnim, staticAnim, staticAnim },
-            TileType::RESIDENTIAL, 300, 50, 6);
-    tileAtlas["commercial"] =
-        Tile(this->tileSize, 2, texmgr.getRef("commercial"),
+            TileType::RESIDENTIAL, 300, 50, 6));
+    this->tileAtlas.add("commercial",
+        TilePrototype(this->tileSize, 2, texmgr.getHandle("commercial"),
             { staticAnim, staticAnim, staticAnim, staticAnim},
-            TileType::COMMERCIAL, 300, 50, 4);
-    tileAtlas["industrial"] =
-        Tile(this->tileSize, 2, texmgr.getRef("industrial"),
+            TileType::COMMERCIAL, 300, 50, 4));
+    this->tileAtlas.add("industrial",
+        TilePrototype(this->tileSize, 2, texmgr.getHandle("industrial"),
             { staticAnim, staticAnim, staticAnim,
             staticAnim },
-            TileType::INDUSTRIAL, 300, 50, 4);
-    tileAtlas["road"] =
-        Tile(this->tileSize, 1, texmgr.getRef("road"),
+            TileType::INDUSTRIAL, 300, 50, 4));
+    this->tileAtlas.add("road",
+        TilePrototype(this->tileSize, 1, texmgr.getHandle("road"),
             { staticAnim, staticAnim, staticAnim,
             staticAnim, staticAnim, staticAnim,
             staticAnim, staticAnim, staticAnim,
             staticAnim, staticAnim },
-            TileType::ROAD, 100, 0, 1);
+            TileType::ROAD, 100, 0, 1));
 
     return;
 }
 
 void Game::loadTextures()
 {
-    texmgr.loadTexture("grass",         "media/grass.png");
-    texmgr.loadTexture("forest",        "media/forest.png");
-    texmgr.loadTexture("water",         "media/water.png");
-    texmgr.loadTexture("residential",   "media/residential.png");
-    texmgr.loadTexture("commercial",    "media/commercial.png");
-    texmgr.loadTexture("industrial",    "media/industrial.png");
-    texmgr.loadTexture("road",          "media/road.png");
-
-    texmgr.loadTexture("background",    "media/background.png");
+    const std::vector<std::pair<std::string, std::string>> textures =
+    {
+        { "grass",          "media/grass.png" },
+        { "forest",         "media/forest.png" },
+        { "water",          "media/water.png" },
+        { "residential",    "media/residential.png" },
+        { "commercial",     "media/commercial.png" },
+        { "industrial",     "media/industrial.png" },
+        { "road",           "media/road.png" },
+
+        { "background",     "media/background.png" }
+    };
+
+    /* Textures are only loaded when first used, so a headless game
+     * never loads any */
+    for(auto& texture : textures)
+    {
+        texmgr.registerTexture(texture.first, texture.second);
+    }
 }
 
 void Game::loadFonts()
@@ -115,6 +130,46 @@ GameState* Game::peekState()
     return this->states.top();
 }
 
+void Game::beginLoading()
+{
+    TraceZone zone("Game::beginLoading");
+    this->loadTextures();
+
+    /* Only the textures needed before the map is shown are loaded up
+     * front, decoded in parallel. The rest load on first use */
+    this->texmgr.queueTexture(this->texmgr.getHandle("background"));
+    this->numTexturesLoading = this->texmgr.numQueued();
+    this->texmgr.decodeQueued(this->threadPool);
+
+    return;
+}
+
+bool Game::continueLoading()
+{
+    if(this->texmgr.uploadDecoded() > 0) return false;
+
+    /* Every texture is available, so the rest can be loaded */
+    TraceZone zone("Game::continueLoading");
+    this->numTexturesLoading = 0;
+    this->loadTiles();
+    this->loadFonts();
+    this->loadStylesheets();
+
+    this->background.setTexture(this->texmgr.getRef("background"));
+
+    std::cout << "Loaded assets after "
+        << this->startupClock.getElapsedTime().asSeconds() << "s" << std::endl;
+
+    return true;
+}
+
+float Game::loadingProgress()
+{
+    if(this->numTexturesLoading == 0) return 1.0f;
+
+    return 1.0f - float(this->texmgr.numQueued()) / this->numTexturesLoading;
+}
+
 void Game::gameLoop()
 {
     sf::Clock clock;
@@ -124,26 +179,48 @@ void Game::gameLoop()
         sf::Time elapsed = clock.restart();
         float dt = elapsed.asSeconds();
 
+        this->texmgr.newFrame();
+
         if(peekState() == nullptr) continue;
+        TraceZone frame("frame");
+        TraceZone phase("input");
         peekState()->handleInput();
+        phase.next("update");
         peekState()->update(dt);
+        phase.next("draw");
         this->window.clear(sf::Color::Black);
         peekState()->draw(dt);
+        phase.next("display");
         this->window.display();
+
+        if(this->firstFrame)
+        {
+            std::cout << "First frame after "
+                << this->startupClock.getElapsedTime().asSeconds() << "s" << std::endl;
+            this->firstFrame = false;
+        }
     }
 }
 
-Game::Game()
+Game::Game(bool headless)
 {
-    this->loadTextures();
-    this->loadTiles();
-	this->loadFonts();
-	this->loadStylesheets();
-	
+    this->headless = headless;
+    this->numTexturesLoading = 0;
+    this->firstFrame = true;
+
+    /* Without a window there is nothing to show while loading, and
+     * the blank textures are ready immediately */
+    if(this->headless)
+    {
+        this->loadTextures();
+        this->loadTiles();
+        return;
+    }
+
+    /* Open the window first so that a loading screen can be shown while
+     * the assets are loaded by beginLoading() */
     this->window.create(sf::VideoMode(800, 600), "City Builder");
     this->window.setFramerateLimit(60);
-
-    this->background.setTexture(this->texmgr.getRef("background"));
 }
 
 Game::~Game()
@@ -9,6 +9,7 @@
 #include "texture_manager.hpp"
 #include "tile.hpp"
 #include "gui.hpp"
+#include "thread_pool.hpp"
 
 class GameState;
 
@@ -21,17 +22,36 @@ class Game
 	void loadStylesheets();
 	void loadFonts();
 
+	/* Number of textures being loaded by beginLoading() */
+	unsigned int numTexturesLoading;
+
+	/* True until the first frame has been displayed */
+	bool firstFrame;
+
 	public:
 
 	const static int tileSize = 8;
 
+	/* True if the game only runs the simulation, with no window or
+	 * textures */
+	bool headless;
+
+	/* Time since the game was created, used to report start up times */
+	sf::Clock startupClock;
+
 	std::stack<GameState*> states;
 
+	/* Threads shared by anything that wants to split up its work. It
+	 * comes before anything that may still have jobs on it when the
+	 * game is destroyed */
+	ThreadPool threadPool;
+
 	sf::RenderWindow window;
 	TextureManager texmgr;
 	sf::Sprite background;
 
-	std::map<std::string, Tile> tileAtlas;
+	TileAtlas tileAtlas;
+
 	std::map<std::string, GuiStyle> stylesheets;
 	std::map<std::string, sf::Font> fonts;
 
@@ -42,7 +62,18 @@ class Game
 
     void gameLoop();
 
-    Game();
+    /* Start decoding the textures in the background */
+    void beginLoading();
+
+    /* Upload any textures decoded since the last call and, once they are
+     * all available, load the assets that depend on them. Returns true
+     * when everything has been loaded */
+    bool continueLoading();
+
+    /* Proportion of the textures that have been loaded */
+    float loadingProgress();
+
+    Game(bool headless = false);
     ~Game();
 };
 
@@ -12,6 +12,8 @@ class GameState
     virtual void draw(const float dt) = 0;
     virtual void update(const float dt) = 0;
     virtual void handleInput() = 0;
+
+    virtual ~GameState() { }
 };
 
 #endif /* GAME_STATE_HPP */
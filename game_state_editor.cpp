@@ -1,8 +1,17 @@
 #include <SFML/Graphics.hpp>
+#include <SFML/System.hpp>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <algorithm>
 
 #include "game_state.hpp"
 #include "game_state_editor.hpp"
 #include "map.hpp"
+#include "replay.hpp"
+#include "trace.hpp"
+#include "memory.hpp"
 
 void GameStateEditor::draw(const float dt)
 {
@@ -12,7 +21,7 @@ void GameStateEditor::draw(const float dt)
 	this->game->window.draw(this->game->background);
 	
     this->game->window.setView(this->gameView);
-    this->city.map.draw(this->game->window, dt);
+    this->city.map.draw(this->game->window, this->game->texmgr, dt);
 
 	this->game->window.setView(this->guiView);
 	for(auto gui : this->guiSystem) this->game->window.draw(gui.second);
@@ -22,11 +31,62 @@ void GameStateEditor::draw(const float dt)
 
 void GameStateEditor::update(const float dt)
 {
-	this->city.update(dt);
+	if(this->replaying)
+	{
+		/* Simulate as many days as fit in a frame */
+		sf::Clock frameClock;
+		while(frameClock.getElapsedTime().asSeconds() < 1.0f / 60.0f)
+		{
+			this->replay.apply(this->city, this->game->tileAtlas);
+			if(this->replay.finished(this->city))
+			{
+				float elapsed = this->replayClock.getElapsedTime().asSeconds();
+				int days = this->city.day - this->replayStartDay;
+				std::cout << "Replayed " << days << " days in " << elapsed << "s ("
+					<< days / elapsed << " days/s)" << std::endl;
+				this->replaying = false;
+				break;
+			}
+			this->city.simulateDay();
+		}
+	}
+	else
+	{
+		/* Commands take effect at the end of the day, as they do in a
+		 * replay */
+		this->city.update(dt, [this]()
+		{
+			this->commands.apply(this->city, this->game->tileAtlas, &this->recorder);
+		});
+	}
+
+	/* Show what the player's placements cost */
+	CommandResult result;
+	while(this->commands.poll(result))
+	{
+		if(result.command.type != CommandType::PLACE_TILES || result.cost == 0) continue;
+		this->lastCharge = result.cost;
+		this->chargeTime = 2.0f;
+	}
+	this->chargeTime = std::max(this->chargeTime - dt, 0.0f);
+
+	/* Adding up the memory means visiting everything, so only do it
+	 * once a second */
+	if(this->guiSystem.at("memoryOverlay").visible)
+	{
+		this->memoryTime -= dt;
+		if(this->memoryTime <= 0.0f)
+		{
+			this->refreshMemoryOverlay();
+			this->memoryTime = 1.0f;
+		}
+	}
 
 	/* Update the info bar at the bottom of the screen */
-	this->guiSystem.at("infoBar").setEntryText(0, "Day: " + std::to_string(this->city.day));
-	this->guiSystem.at("infoBar").setEntryText(1, "$" + std::to_string(long(this->city.funds)));
+	std::string funds = "$" + std::to_string(long(this->city.funds));
+	if(this->chargeTime > 0.0f) funds += " (-$" + std::to_string(this->lastCharge) + ")";
+	this->guiSystem.at("infoBar").setEntryText(0, "Day: " + std::to_string(this->city.day) + (this->city.paused ? " (paused)" : ""));
+	this->guiSystem.at("infoBar").setEntryText(1, funds);
 	this->guiSystem.at("infoBar").setEntryText(2, std::to_string(long(this->city.population)) + " (" + std::to_string(long(this->city.getHomeless())) + ")");
 	this->guiSystem.at("infoBar").setEntryText(3, std::to_string(long(this->city.employable)) + " (" + std::to_string(long(this->city.getUnemployed())) + ")");
 	this->guiSystem.at("infoBar").setEntryText(4, tileTypeToStr(currentTile->tileType));
@@ -34,6 +94,41 @@ void GameStateEditor::update(const float dt)
 	return;
 }
 
+void GameStateEditor::getMemory(MemoryReport& report)
+{
+	this->city.getMemory(report);
+	report.add("textures", this->game->texmgr.getResidentBytes());
+
+	std::size_t gui = 0;
+	for(auto& entry : this->guiSystem) gui += entry.second.getMemory();
+	report.add("gui", gui);
+
+	return;
+}
+
+void GameStateEditor::refreshMemoryOverlay()
+{
+	MemoryReport report;
+	this->getMemory(report);
+
+	Gui& overlay = this->guiSystem.at("memoryOverlay");
+	for(unsigned int i = 0; i < report.entries.size(); ++i)
+		overlay.setEntryText(i, report.entries[i].first + ": " + MemoryReport::format(report.entries[i].second));
+	overlay.setEntryText(report.entries.size(), "total: " + MemoryReport::format(report.getTotal()));
+
+	return;
+}
+
+void GameStateEditor::submit(const Command& command)
+{
+	/* Input arrives far slower than a day is simulated, so a full queue
+	 * means the simulation has stalled */
+	if(!this->commands.submit(command))
+		std::cerr << "Error, too many commands waiting to be applied" << std::endl;
+
+	return;
+}
+
 void GameStateEditor::handleInput()
 {
 	sf::Event event;
@@ -62,20 +157,7 @@ void GameStateEditor::handleInput()
 					selectionEnd.y = pos.y / (this->city.map.tileSize) - pos.x / (2*this->city.map.tileSize) + this->city.map.width * 0.5 + 0.5;
 
 					this->city.map.clearSelected();
-					if(this->currentTile->tileType == TileType::GRASS)
-					{
-						this->city.map.select(selectionStart, selectionEnd, {this->currentTile->tileType, TileType::WATER});
-					}
-					else
-					{
-						this->city.map.select(selectionStart, selectionEnd,
-						    {
-						        this->currentTile->tileType,    TileType::FOREST,
-						        TileType::WATER,                TileType::ROAD,
-						        TileType::RESIDENTIAL,          TileType::COMMERCIAL,
-						        TileType::INDUSTRIAL
-						    });
-				    }
+					this->city.selectForPlacement(selectionStart, selectionEnd, this->currentTile->tileType);
 				    
 				    this->guiSystem.at("selectionCostText").setEntryText(0, "$" + std::to_string(this->currentTile->cost * this->city.map.numSelected));
 					if(this->city.funds <= this->city.map.numSelected * this->currentTile->cost)
@@ -116,8 +198,8 @@ void GameStateEditor::handleInput()
 					/* Select map tile */
 					else
 					{
-                        /* Select map tile */
-					    if(this->actionState != ActionState::SELECTING)
+                        /* Select map tile, unless a replay is in control of the city */
+					    if(this->actionState != ActionState::SELECTING && !this->replaying)
 					    {
 						    this->actionState = ActionState::SELECTING;
 						    selectionStart.x = gamePos.y / (this->city.map.tileSize) + gamePos.x / (2*this->city.map.tileSize) - this->city.map.width * 0.5 - 0.5;
@@ -168,13 +250,8 @@ void GameStateEditor::handleInput()
 						/* Replace tiles if enough funds and a tile is selected */
 						if(this->currentTile != nullptr)
 						{
-							unsigned int cost = this->currentTile->cost * this->city.map.numSelected;
-							if(this->city.funds >= cost)
-							{
-								this->city.bulldoze(*this->currentTile);
-								this->city.funds -= this->currentTile->cost * this->city.map.numSelected;
-								this->city.tileChanged();
-							}
+							this->submit(Command(this->city.day, this->selectionStart, this->selectionEnd,
+								this->currentTile->tileType));
 						}
 					    this->guiSystem.at("selectionCostText").hide();
 						this->actionState = ActionState::NONE;
@@ -198,6 +275,69 @@ void GameStateEditor::handleInput()
 				}
 				break;
 			}
+			case sf::Event::KeyPressed:
+			{
+				/* Show how much memory each part of the game uses */
+				if(event.key.code == sf::Keyboard::F3)
+				{
+					Gui& overlay = this->guiSystem.at("memoryOverlay");
+					if(overlay.visible) overlay.hide();
+					else
+					{
+						this->memoryTime = 0.0f;
+						overlay.show();
+					}
+					break;
+				}
+
+				/* Pause and change the speed of the simulation */
+				if(!event.key.control)
+				{
+					if(this->replaying) break;
+
+					Command command(this->city.day, CommandType::SET_SPEED);
+					if(event.key.code == sf::Keyboard::Space)
+					{
+						command.type = CommandType::PAUSE;
+						command.paused = !this->city.paused;
+					}
+					else if(event.key.code == sf::Keyboard::Num1)	command.speed = 1.0f;
+					else if(event.key.code == sf::Keyboard::Num2)	command.speed = 2.0f;
+					else if(event.key.code == sf::Keyboard::Num3)	command.speed = 4.0f;
+					else break;
+
+					this->submit(command);
+					break;
+				}
+
+				/* Export the city's statistics */
+				if(event.key.code == sf::Keyboard::E)
+				{
+					this->city.stats.exportCSV(this->cityName + "_stats.csv");
+					this->city.stats.exportJSON(this->cityName + "_stats.json");
+					break;
+				}
+
+				/* Write out what the flight recorder has kept */
+				if(event.key.code == sf::Keyboard::T)
+				{
+					if(tracer.enabled) tracer.save(this->cityName + "_trace.json");
+					break;
+				}
+
+				if(this->replaying || this->actionState == ActionState::SELECTING) break;
+
+				CommandType type = CommandType::END;
+				if(event.key.code == sf::Keyboard::Z && !event.key.shift)
+					type = CommandType::UNDO;
+				else if(event.key.code == sf::Keyboard::Y || event.key.code == sf::Keyboard::Z)
+					type = CommandType::REDO;
+				if(type == CommandType::END) break;
+
+				/* Undo and redo tile placements */
+				this->submit(Command(this->city.day, type));
+				break;
+			}
 			/* Close the window */
 			case sf::Event::Closed:
 			{
@@ -226,7 +366,7 @@ void GameStateEditor::handleInput()
 	return;
 }
 
-GameStateEditor::GameStateEditor(Game* game)
+GameStateEditor::GameStateEditor(Game* game, const std::string& replayFile)
 {
 	this->game = game;
 	sf::Vector2f pos = sf::Vector2f(this->game->window.getSize());
@@ -236,9 +376,27 @@ GameStateEditor::GameStateEditor(Game* game)
 	this->guiView.setCenter(pos);
 	this->gameView.setCenter(pos);
 
-    this->city = City("city", this->game->tileSize, this->game->tileAtlas);
+	/* Seed the simulation so that the session can be replayed */
+	this->cityName = "city";
+	unsigned int seed = std::time(nullptr);
+	this->replaying = !replayFile.empty() && this->replay.load(replayFile);
+	if(this->replaying)
+	{
+		this->cityName = this->replay.cityName;
+		seed = this->replay.seed;
+	}
+
+    this->city = City(this->cityName, this->game->tileSize, this->game->tileAtlas);
+	this->city.random.seed(seed);
 	this->city.shuffleTiles();
 
+	if(!this->replaying)
+		this->recorder.open(this->cityName + "_session.dat", this->cityName, seed);
+	this->replayStartDay = this->city.day;
+	this->lastCharge = 0;
+	this->chargeTime = 0.0f;
+	this->replayClock.restart();
+
     /* Create gui elements */
 	this->guiSystem.emplace("rightClickMenu", Gui(sf::Vector2f(196, 16), 2, false, this->game->stylesheets.at("button"),
 		{
@@ -261,6 +419,14 @@ GameStateEditor::GameStateEditor(Game* game)
 		std::make_pair("current tile", "tile") }));
 	this->guiSystem.at("infoBar").setPosition(sf::Vector2f(0, this->game->window.getSize().y - 16));
 	this->guiSystem.at("infoBar").show();
+
+	/* One line for each part of the game and one for the total */
+	MemoryReport report;
+	this->getMemory(report);
+	this->guiSystem.emplace("memoryOverlay", Gui(sf::Vector2f(256, 16), 0, false, this->game->stylesheets.at("text"),
+		std::vector<std::pair<std::string, std::string>>(report.entries.size() + 1)));
+	this->guiSystem.at("memoryOverlay").setPosition(sf::Vector2f(0, 0));
+	this->memoryTime = 0.0f;
 	
 	this->zoomLevel = 1.0f;
 	
@@ -276,3 +442,7 @@ GameStateEditor::GameStateEditor(Game* game)
 	this->actionState = ActionState::NONE;
 }
 
+GameStateEditor::~GameStateEditor()
+{
+	this->recorder.close(this->city.day);
+}
@@ -9,6 +9,8 @@
 #include "map.hpp"
 #include "gui.hpp"
 #include "city.hpp"
+#include "replay.hpp"
+#include "command_queue.hpp"
 
 enum class ActionState { NONE, PANNING, SELECTING };
 
@@ -22,6 +24,7 @@ class GameStateEditor : public GameState
 	sf::View guiView;
     
     City city;
+    std::string cityName;
 
     sf::Vector2i panningAnchor;
     float zoomLevel;
@@ -29,17 +32,49 @@ class GameStateEditor : public GameState
     sf::Vector2i selectionStart;
     sf::Vector2i selectionEnd;
     
-    Tile* currentTile;
+    TilePrototype* currentTile;
     
     std::map<std::string, Gui> guiSystem;
 
+    /* Commands issued by the player, applied to the city between days.
+     * Every command is recorded so the session can be replayed */
+    CommandQueue commands;
+    Recorder recorder;
+
+    /* Amount charged by the last placement, shown in the info bar until
+     * chargeTime runs out */
+    unsigned int lastCharge;
+    float chargeTime;
+
+    /* Queue a command made by the player */
+    void submit(const Command& command);
+
+    /* Time until the memory overlay is next refreshed */
+    float memoryTime;
+
+    /* Add the memory used by the city, textures and gui to the report */
+    void getMemory(MemoryReport& report);
+
+    /* Show the latest memory usage in the overlay */
+    void refreshMemoryOverlay();
+
+    /* If true the city is driven by the replay instead of the player,
+     * running as fast as possible */
+    bool replaying;
+    Replay replay;
+    sf::Clock replayClock;
+    int replayStartDay;
+
 	public:
 
 	virtual void draw(const float dt);
 	virtual void update(const float dt);
 	virtual void handleInput();
 
-	GameStateEditor(Game* game);
+	/* Start the editor. If replayFile is not empty the recorded session
+	 * is played back instead of recording a new one */
+	GameStateEditor(Game* game, const std::string& replayFile = "");
+	virtual ~GameStateEditor();
 };
 
 #endif /* GAME_STATE_EDITOR_HPP */
@@ -0,0 +1,82 @@
+#include <SFML/Graphics.hpp>
+#include <functional>
+
+#include "game_state_loading.hpp"
+#include "game_state.hpp"
+
+void GameStateLoading::draw(const float dt)
+{
+    this->game->window.setView(this->view);
+
+    this->game->window.clear(sf::Color::Black);
+
+    /* Draw the progress bar in the centre of the screen */
+    sf::Vector2f size(this->view.getSize().x * 0.5f, 16);
+    sf::RectangleShape border(size);
+    border.setOrigin(size * 0.5f);
+    border.setPosition(this->view.getCenter());
+    border.setFillColor(sf::Color(0x00, 0x00, 0x00));
+    border.setOutlineThickness(1);
+    border.setOutlineColor(sf::Color(0xc6, 0xc6, 0xc6));
+    this->game->window.draw(border);
+
+    sf::RectangleShape bar(sf::Vector2f(size.x * this->game->loadingProgress(), size.y));
+    bar.setOrigin(size * 0.5f);
+    bar.setPosition(this->view.getCenter());
+    bar.setFillColor(sf::Color(0x94, 0x94, 0x94));
+    this->game->window.draw(bar);
+
+    return;
+}
+
+void GameStateLoading::update(const float dt)
+{
+    if(!this->game->continueLoading()) return;
+
+    /* This state is deleted by changeState, so nothing may be
+     * accessed after it */
+    this->game->changeState(this->nextState());
+
+    return;
+}
+
+void GameStateLoading::handleInput()
+{
+    sf::Event event;
+
+    while(this->game->window.pollEvent(event))
+    {
+        switch(event.type)
+        {
+            /* Close the window */
+            case sf::Event::Closed:
+            {
+                this->game->window.close();
+                break;
+            }
+            /* Resize the window */
+            case sf::Event::Resized:
+            {
+                this->view.setSize(event.size.width, event.size.height);
+                this->view.setCenter(event.size.width * 0.5f, event.size.height * 0.5f);
+                break;
+            }
+            default: break;
+        }
+    }
+
+    return;
+}
+
+GameStateLoading::GameStateLoading(Game* game, std::function<GameState*()> nextState)
+{
+    this->game = game;
+    this->nextState = nextState;
+
+    sf::Vector2f pos = sf::Vector2f(this->game->window.getSize());
+    this->view.setSize(pos);
+    pos *= 0.5f;
+    this->view.setCenter(pos);
+
+    this->game->beginLoading();
+}
@@ -0,0 +1,28 @@
+#ifndef GAME_STATE_LOADING_HPP
+#define GAME_STATE_LOADING_HPP
+
+#include <SFML/Graphics.hpp>
+#include <functional>
+
+#include "game_state.hpp"
+
+/* Displays a progress bar while the game's assets load, then replaces
+ * itself with the state created by nextState */
+class GameStateLoading : public GameState
+{
+    private:
+
+    sf::View view;
+
+    std::function<GameState*()> nextState;
+
+    public:
+
+    virtual void draw(const float dt);
+    virtual void update(const float dt);
+    virtual void handleInput();
+
+    GameStateLoading(Game* game, std::function<GameState*()> nextState);
+};
+
+#endif /* GAME_STATE_LOADING_HPP */
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "generator.hpp"
+#include "thread_pool.hpp"
+
+/* Well mixed 32 bit hash of a lattice point */
+static unsigned int hash(int x, int y, unsigned int seed)
+{
+    unsigned int h = seed * 0x9e3779b9u ^ unsigned(x) * 0x85ebca6bu ^ unsigned(y) * 0xc2b2ae35u;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+
+    return h;
+}
+
+/* Random value at each lattice point, smoothly interpolated between */
+static float valueNoise(float x, float y, unsigned int seed)
+{
+    int x0 = int(std::floor(x));
+    int y0 = int(std::floor(y));
+    float tx = x - x0;
+    float ty = y - y0;
+    tx = tx * tx * (3 - 2 * tx);
+    ty = ty * ty * (3 - 2 * ty);
+
+    const float norm = 1.0f / 4294967296.0f;
+    float a = hash(x0, y0, seed) * norm;
+    float b = hash(x0+1, y0, seed) * norm;
+    float c = hash(x0, y0+1, seed) * norm;
+    float d = hash(x0+1, y0+1, seed) * norm;
+
+    return (a + (b - a) * tx) * (1 - ty) + (c + (d - c) * tx) * ty;
+}
+
+float CityGenerator::noise(float x, float y, unsigned int salt) const
+{
+    /* Each octave is half the size and strength of the last */
+    float sum = 0.0f;
+    float amplitude = 0.5f;
+    float frequency = 1.0f / this->scale;
+    for(int octave = 0; octave < 4; ++octave)
+    {
+        sum += amplitude * valueNoise(x * frequency, y * frequency, this->seed + salt + octave);
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+
+    return sum / 0.9375f;
+}
+
+TileType CityGenerator::getTile(int x, int y) const
+{
+    if(this->noise(x, y, 0) < this->waterLevel) return TileType::WATER;
+    if(this->noise(x, y, 100) < this->forestLevel) return TileType::FOREST;
+    if(this->roadSpacing == 0) return TileType::GRASS;
+
+    if(x % this->roadSpacing == 0 || y % this->roadSpacing == 0) return TileType::ROAD;
+
+    /* Zone whole blocks at once, leaving some empty */
+    unsigned int block = hash(x / this->roadSpacing, y / this->roadSpacing, this->seed + 200) % 100;
+    if(block < 60) return TileType::RESIDENTIAL;
+    if(block < 80) return TileType::COMMERCIAL;
+    if(block < 90) return TileType::INDUSTRIAL;
+
+    return TileType::GRASS;
+}
+
+bool CityGenerator::save(const std::string& cityName, ThreadPool& pool) const
+{
+    std::ofstream mapFile(cityName + "_map.dat", std::ios::out | std::ios::binary);
+    if(!mapFile.is_open())
+    {
+        std::cerr << "Error, could not write " << cityName << "_map.dat" << std::endl;
+        return false;
+    }
+
+    /* Each tile is stored as Map::save writes it */
+    const unsigned int tileBytes = 3*sizeof(int) + sizeof(double) + sizeof(float);
+    unsigned int chunkSize = std::max(1u, this->chunkSize);
+    unsigned int numChunks = (this->height + chunkSize - 1) / chunkSize;
+
+    /* Generate one chunk per thread at a time, so memory only grows
+     * with the width of the map */
+    std::vector<std::vector<char>> buffers(pool.getNumThreads());
+    std::vector<unsigned int> residential(pool.getNumThreads(), 0);
+    unsigned int totalResidential = 0;
+    for(unsigned int first = 0; first < numChunks; first += buffers.size())
+    {
+        unsigned int batch = std::min<unsigned int>(buffers.size(), numChunks - first);
+        pool.parallelFor(batch, 1, [&](unsigned int begin, unsigned int end, unsigned int thread)
+        {
+            for(unsigned int i = begin; i < end; ++i)
+            {
+                unsigned int y0 = (first + i) * chunkSize;
+                unsigned int y1 = std::min(y0 + chunkSize, this->height);
+                std::vector<char>& buffer = buffers[i];
+                buffer.resize((y1 - y0) * this->width * tileBytes);
+                residential[i] = 0;
+
+                char* out = buffer.data();
+                for(unsigned int y = y0; y < y1; ++y)
+                {
+                    for(unsigned int x = 0; x < this->width; ++x)
+                    {
+                        Tile tile(this->getTile(x, y));
+                        if(tile.tileType == TileType::RESIDENTIAL) ++residential[i];
+
+                        std::memcpy(out, &tile.tileType, sizeof(int));          out += sizeof(int);
+                        std::memcpy(out, &tile.tileVariant, sizeof(int));       out += sizeof(int);
+                        std::memcpy(out, &tile.regions[0], sizeof(int));        out += sizeof(int);
+                        std::memcpy(out, &tile.population, sizeof(double));     out += sizeof(double);
+                        std::memcpy(out, &tile.storedGoods, sizeof(float));     out += sizeof(float);
+                    }
+                }
+            }
+        });
+
+        for(unsigned int i = 0; i < batch; ++i)
+        {
+            mapFile.write(buffers[i].data(), buffers[i].size());
+            totalResidential += residential[i];
+        }
+    }
+    mapFile.close();
+
+    std::ofstream cfgFile(cityName + "_cfg.dat", std::ios::out);
+    if(!cfgFile.is_open())
+    {
+        std::cerr << "Error, could not write " << cityName << "_cfg.dat" << std::endl;
+        return false;
+    }
+
+    /* Start with a couple of residents for every residential zone */
+    double population = std::max(50.0, 2.0 * totalResidential);
+    cfgFile << "width="             << this->width      << std::endl;
+    cfgFile << "height="            << this->height     << std::endl;
+    cfgFile << "day="               << 0                << std::endl;
+    cfgFile << "populationPool="    << population       << std::endl;
+    cfgFile << "employmentPool="    << population / 2   << std::endl;
+    cfgFile << "population="        << population       << std::endl;
+    cfgFile << "employable="        << population / 2   << std::endl;
+    cfgFile << "funds="             << 30000            << std::endl;
+    cfgFile.close();
+
+    return true;
+}
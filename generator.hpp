@@ -0,0 +1,62 @@
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+
+#include <string>
+
+#include "tile.hpp"
+
+class ThreadPool;
+
+/* Generates cities of any size from a seed. Terrain comes from fractal
+ * value noise, and can be covered by a grid of roads with blocks zoned
+ * between them. Every tile depends only on its position and the seed,
+ * so the map can be generated in any order and split across threads */
+class CityGenerator
+{
+    private:
+
+    /* Noise in [0, 1) with features about scale tiles across */
+    float noise(float x, float y, unsigned int salt) const;
+
+    public:
+
+    unsigned int width;
+    unsigned int height;
+    unsigned int seed;
+
+    /* Tiles where the height noise is below waterLevel are water, and
+     * land where the forest noise is below forestLevel is forest. The
+     * noise is rarely far from 0.5 */
+    float waterLevel;
+    float forestLevel;
+
+    /* Size of the largest terrain features, in tiles */
+    float scale;
+
+    /* Distance between roads, or 0 for bare terrain */
+    unsigned int roadSpacing;
+
+    /* Rows generated by each task */
+    unsigned int chunkSize;
+
+    TileType getTile(int x, int y) const;
+
+    /* Write name_cfg.dat and name_map.dat. Chunks are generated in
+     * parallel and written out in order, so the whole map is never held
+     * in memory. Return false if the files could not be written */
+    bool save(const std::string& cityName, ThreadPool& pool) const;
+
+    CityGenerator(unsigned int width, unsigned int height, unsigned int seed)
+    {
+        this->width = width;
+        this->height = height;
+        this->seed = seed;
+        this->waterLevel = 0.4f;
+        this->forestLevel = 0.4f;
+        this->scale = 48.0f;
+        this->roadSpacing = 6;
+        this->chunkSize = 32;
+    }
+};
+
+#endif /* GENERATOR_HPP */
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <vector>
+
+#include "growth_kernel.hpp"
+#include "simd.hpp"
+
+const static int moveRate = 4;
+
+/* Number of zones whose moves are guessed and then checked at once by
+ * the EXACT kernel. A wrong guess costs at most this many scalar updates */
+const static unsigned int chunkSize = 64;
+
+/* Reference version, identical to City::distributePool */
+static void distributeScalar(double* population, const double* capacity,
+    unsigned int begin, unsigned int end, double& pool, double rate)
+{
+    for(unsigned int i = begin; i < end; ++i)
+    {
+        double maxPop = capacity[i];
+
+        if(pool > 0)
+        {
+            int moving = maxPop - population[i];
+            if(moving > moveRate) moving = moveRate;
+            if(pool - moving < 0) moving = pool;
+            pool -= moving;
+            population[i] += moving;
+        }
+
+        population[i] += population[i] * rate;
+
+        if(population[i] > maxPop)
+        {
+            pool += population[i] - maxPop;
+            population[i] = maxPop;
+        }
+    }
+
+    return;
+}
+
+/* Number of residents each zone would take from an unlimited pool */
+static void computeDemand(const double* population, const double* capacity,
+    unsigned int n, int* demand)
+{
+    for(unsigned int i = 0; i < n; ++i)
+    {
+        int moving = capacity[i] - population[i];
+        demand[i] = moving > moveRate ? moveRate : moving;
+    }
+
+    return;
+}
+
+/* Apply the given moves and then births and deaths to n zones, writing
+ * the new populations to grown and how far each is over capacity to
+ * excess. Every operation matches distributeScalar so that the results
+ * are bit-identical */
+static void growScalar(const double* population, const double* capacity, const int* moved,
+    unsigned int n, double rate, double* grown, double* excess)
+{
+    for(unsigned int i = 0; i < n; ++i)
+    {
+        double pop = population[i] + moved[i];
+        pop += pop * rate;
+        excess[i] = pop - capacity[i];
+        grown[i] = pop > capacity[i] ? capacity[i] : pop;
+    }
+
+    return;
+}
+
+#ifdef CITYBUILDER_SSE2
+static void growSSE2(const double* population, const double* capacity, const int* moved,
+    unsigned int n, double rate, double* grown, double* excess)
+{
+    const __m128d r = _mm_set1_pd(rate);
+    unsigned int i = 0;
+    for(; i + 2 <= n; i += 2)
+    {
+        __m128d m = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(moved + i)));
+        __m128d cap = _mm_loadu_pd(capacity + i);
+        __m128d pop = _mm_add_pd(_mm_loadu_pd(population + i), m);
+        pop = _mm_add_pd(pop, _mm_mul_pd(pop, r));
+        _mm_storeu_pd(excess + i, _mm_sub_pd(pop, cap));
+        _mm_storeu_pd(grown + i, _mm_min_pd(pop, cap));
+    }
+    growScalar(population + i, capacity + i, moved + i, n - i, rate, grown + i, excess + i);
+
+    return;
+}
+#endif
+
+#ifdef CITYBUILDER_AVX2
+CITYBUILDER_TARGET_AVX2
+static void growAVX2(const double* population, const double* capacity, const int* moved,
+    unsigned int n, double rate, double* grown, double* excess)
+{
+    const __m256d r = _mm256_set1_pd(rate);
+    unsigned int i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        __m256d m = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(moved + i)));
+        __m256d cap = _mm256_loadu_pd(capacity + i);
+        __m256d pop = _mm256_add_pd(_mm256_loadu_pd(population + i), m);
+        pop = _mm256_add_pd(pop, _mm256_mul_pd(pop, r));
+        _mm256_storeu_pd(excess + i, _mm256_sub_pd(pop, cap));
+        _mm256_storeu_pd(grown + i, _mm256_min_pd(pop, cap));
+    }
+    growScalar(population + i, capacity + i, moved + i, n - i, rate, grown + i, excess + i);
+
+    return;
+}
+#endif
+
+static void grow(const double* population, const double* capacity, const int* moved,
+    unsigned int n, double rate, double* grown, double* excess)
+{
+#if defined(CITYBUILDER_AVX2)
+    if(hasAVX2()) growAVX2(population, capacity, moved, n, rate, grown, excess);
+    else growSSE2(population, capacity, moved, n, rate, grown, excess);
+#elif defined(CITYBUILDER_SSE2)
+    growSSE2(population, capacity, moved, n, rate, grown, excess);
+#else
+    growScalar(population, capacity, moved, n, rate, grown, excess);
+#endif
+
+    return;
+}
+
+/* Only the pool couples the zones together, so guess how many residents
+ * each zone in a chunk receives, grow the whole chunk at once and then
+ * walk the pool through it in order, checking each guess with the same
+ * tests distributeScalar would make. Zones from the first wrong guess
+ * onwards are redone by distributeScalar */
+static void distributeExact(double* population, const double* capacity, unsigned int n,
+    double& pool, double rate)
+{
+    int demand[chunkSize];
+    int moved[chunkSize];
+    double grown[chunkSize];
+    double excess[chunkSize];
+
+    for(unsigned int begin = 0; begin < n; begin += chunkSize)
+    {
+        unsigned int size = std::min(chunkSize, n - begin);
+        computeDemand(population + begin, capacity + begin, size, demand);
+
+        /* A pool large enough for the whole chunk can only grow
+         * from zones overflowing, so every zone will be filled.
+         * Otherwise guess that the pool is empty */
+        int totalDemand = 0;
+        for(unsigned int i = 0; i < size; ++i) totalDemand += demand[i];
+        bool filled = pool >= totalDemand;
+        for(unsigned int i = 0; i < size; ++i) moved[i] = filled ? demand[i] : 0;
+
+        grow(population + begin, capacity + begin, moved, size, rate, grown, excess);
+
+        unsigned int i = 0;
+        for(; i < size; ++i)
+        {
+            if(pool > 0)
+            {
+                /* distributeScalar moves the demand unless that would
+                 * overdraw the pool, in which case it moves its whole
+                 * part, which is nothing if the pool is below 1 */
+                int moving = demand[i];
+                if(pool - moving < 0) moving = pool;
+                if(moving != moved[i]) break;
+                pool -= moving;
+            }
+            else if(moved[i] != 0) break;
+
+            if(excess[i] > 0) pool += excess[i];
+            population[begin + i] = grown[i];
+        }
+        distributeScalar(population, capacity, begin + i, begin + size, pool, rate);
+    }
+
+    return;
+}
+
+/* Every zone draws its demand from what is left of the pool after the
+ * zones before it, which is the pool less the prefix sum of their
+ * demands. Overflow is summed and returned to the pool afterwards */
+static void distributeFast(double* population, const double* capacity, unsigned int n,
+    double& pool, double rate)
+{
+    std::vector<int> moved(n);
+    std::vector<double> grown(n);
+    std::vector<double> excess(n);
+
+    computeDemand(population, capacity, n, moved.data());
+
+    /* Only whole residents can move */
+    double available = pool > 0 ? double(int(pool)) : 0.0;
+    double drawn = 0.0;
+    for(unsigned int i = 0; i < n; ++i)
+    {
+        int demand = moved[i];
+        if(demand > 0)
+        {
+            double left = available - drawn;
+            if(left < demand) demand = left > 0 ? int(left) : 0;
+            drawn += demand;
+        }
+        else if(pool <= 0)
+        {
+            demand = 0;
+        }
+        moved[i] = demand;
+    }
+
+    grow(population, capacity, moved.data(), n, rate, grown.data(), excess.data());
+
+    double returned = 0.0;
+    double moving = 0.0;
+    for(unsigned int i = 0; i < n; ++i)
+    {
+        moving += moved[i];
+        if(excess[i] > 0) returned += excess[i];
+        population[i] = grown[i];
+    }
+    pool += returned - moving;
+
+    return;
+}
+
+void distributeResidents(double* population, const double* capacity, unsigned int n,
+    double& pool, double rate, KernelMode mode)
+{
+    switch(mode)
+    {
+        case KernelMode::SCALAR:
+            distributeScalar(population, capacity, 0, n, pool, rate);
+            break;
+        case KernelMode::EXACT:
+            distributeExact(population, capacity, n, pool, rate);
+            break;
+        case KernelMode::FAST:
+            distributeFast(population, capacity, n, pool, rate);
+            break;
+    }
+
+    return;
+}
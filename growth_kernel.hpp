@@ -0,0 +1,19 @@
+#ifndef GROWTH_KERNEL_HPP
+#define GROWTH_KERNEL_HPP
+
+/* SCALAR processes one zone at a time, exactly as City::distributePool.
+ * EXACT uses SIMD but gives bit-identical results to SCALAR, so it can
+ * be validated against it.
+ * FAST resolves the whole pool at once with a prefix sum over the zones'
+ * demands. Residents overflowing a zone return to the pool for the next
+ * day instead of the next zone, so results differ slightly from SCALAR */
+enum class KernelMode { SCALAR, EXACT, FAST };
+
+/* Move residents from the pool into n residential zones, up to 4 per
+ * zone and in order, then apply births and deaths and return any
+ * residents the zones cannot hold to the pool. population and capacity
+ * are packed arrays holding each zone's residents and maximum residents */
+void distributeResidents(double* population, const double* capacity, unsigned int n,
+    double& pool, double rate, KernelMode mode);
+
+#endif /* GROWTH_KERNEL_HPP */
@@ -2,6 +2,7 @@
 #include <string>
 
 #include "gui.hpp"
+#include "memory.hpp"
 
 sf::Vector2f Gui::getSize()
 {
@@ -133,3 +134,12 @@ std::string Gui::activate(sf::Vector2f mousePos)
     int entry = this->getEntry(mousePos);
     return this->activate(entry);
 }
+
+std::size_t Gui::getMemory() const
+{
+    std::size_t size = sizeof(Gui) + vectorSize(this->entries);
+    for(auto& entry : this->entries)
+        size += entry.message.capacity() + entry.text.getString().getSize() * sizeof(sf::Uint32);
+
+    return size;
+}
@@ -4,6 +4,7 @@
 #include <vector>
 #include <utility>
 #include <string>
+#include <cstddef>
 
 class GuiStyle
 {
@@ -109,6 +110,9 @@ class Gui : public sf::Transformable, public sf::Drawable
 
     sf::Vector2f getSize();
 
+    /* Memory used, in bytes */
+    std::size_t getMemory() const;
+
     /* Return the entry that the mouse is hovering over. Returns
      * -1 if the mouse if outside of the Gui */
     int getEntry(const sf::Vector2f mousePos);
@@ -0,0 +1,369 @@
+#include <SFML/System.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "game.hpp"
+#include "city.hpp"
+#include "replay.hpp"
+#include "simd.hpp"
+#include "city_host.hpp"
+#include "generator.hpp"
+#include "trace.hpp"
+#include "perf_counters.hpp"
+#include "memory.hpp"
+#include "regression.hpp"
+
+/* Run several cities at once in a CityHost and report how fast each ran */
+static int runHost(Game& game, const std::vector<std::string>& cityNames, int copies,
+    int days, unsigned int seed, KernelMode kernel)
+{
+    CityHost host;
+    for(auto& name : cityNames)
+    {
+        for(int i = 0; i < copies; ++i)
+            host.add(name, game.tileSize, game.tileAtlas, seed + host.size()).city.growthKernel = kernel;
+    }
+
+    double elapsed = host.run(days, game.threadPool);
+
+    for(unsigned int i = 0; i < host.size(); ++i)
+    {
+        const HostedCity& hosted = host[i];
+        std::cout << "City " << i << " (" << hosted.name << "): " << hosted.days << " days in "
+            << hosted.seconds << "s (" << hosted.days / hosted.seconds << " days/s)"
+            << ", population " << long(hosted.city.population)
+            << ", funds $" << long(hosted.city.funds) << std::endl;
+    }
+    std::cout << "Simulated " << host.size() << " cities for " << days << " days in " << elapsed << "s ("
+        << host.size() * days / elapsed << " days/s, " << game.threadPool.getNumThreads() << " threads)"
+        << std::endl;
+    if(counters.enabled) counters.print(std::cout, host.size() * days, "city day");
+    counters.stop();
+
+    return 0;
+}
+
+/* Write how fast the city ran, what the hardware counted while it ran
+ * and the memory it used, to a JSON file for comparing builds and
+ * changes */
+static bool writeBenchmark(const std::string& filename, const std::string& cityName,
+    const City& city, int days, float elapsed, unsigned int numThreads, const MemoryReport& memory)
+{
+    std::ofstream outputFile(filename, std::ios::out);
+    if(!outputFile.is_open())
+    {
+        std::cerr << "Error, could not open " << filename << std::endl;
+        return false;
+    }
+
+    outputFile << "{" << std::endl
+        << "  \"city\": \"" << cityName << "\"," << std::endl
+        << "  \"tiles\": " << city.map.tiles.size() << "," << std::endl
+        << "  \"days\": " << days << "," << std::endl
+        << "  \"seconds\": " << elapsed << "," << std::endl
+        << "  \"daysPerSecond\": " << days / elapsed << "," << std::endl
+        << "  \"threads\": " << numThreads << "," << std::endl
+        << "  \"growthKernel\": \"" << simdInstructionSet() << "\"," << std::endl
+        << "  \"population\": " << long(city.population) << "," << std::endl
+        << "  \"funds\": " << long(city.funds) << "," << std::endl
+        << "  \"bytesPerTile\": " << double(memory.getTotal()) / city.map.tiles.size() << "," << std::endl
+        << "  \"memory\": ";
+    memory.printJSON(outputFile);
+    outputFile << "," << std::endl << "  \"countersPerDay\": ";
+    if(counters.enabled) counters.printJSON(outputFile, days);
+    else outputFile << "null";
+    outputFile << std::endl << "}" << std::endl;
+
+    return true;
+}
+
+/* Runs the simulation without a window, either for a fixed number of
+ * days or by replaying a recorded session, and reports how fast it ran */
+int main(int argc, char* argv[])
+{
+    std::string cityName = "city";
+    /* Every city given, and how many times to load each of them */
+    std::vector<std::string> cityNames;
+    int copies = 1;
+    std::string replayFile;
+    int days = 360;
+    /* The C library's default seed */
+    unsigned int seed = 1;
+    KernelMode kernel = KernelMode::EXACT;
+    /* Number of routes to find between random road tiles */
+    int numPaths = 0;
+    /* File to export the city's statistics to, as JSON if it ends
+     * in .json and as CSV otherwise */
+    std::string statsFile;
+    /* City to generate before running, and its size and road spacing */
+    std::string generateName;
+    unsigned int generateWidth = 256;
+    unsigned int generateHeight = 256;
+    unsigned int roadSpacing = 6;
+    /* Threads to split work across, or 0 for one per core */
+    unsigned int numThreads = 0;
+    /* File to write a trace of the run to */
+    std::string traceFile;
+    /* Count hardware events in each pass */
+    bool countEvents = false;
+    /* File to write the speed of the run to, as JSON */
+    std::string benchmarkFile;
+    /* Report the memory used by each part of the city */
+    bool reportMemory = false;
+    /* Name to save the city under once it has run */
+    std::string saveName;
+    /* Golden record to write, or to compare the run against, and the
+     * days between its samples */
+    std::string goldenFile;
+    std::string verifyFile;
+    int interval = 30;
+    /* Random edits to check the map's functions against */
+    int mapRounds = 0;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg == "--city" && i+1 < argc)           cityNames.push_back(argv[++i]);
+        else if(arg == "--copies" && i+1 < argc)    copies = std::stoi(argv[++i]);
+        else if(arg == "--days" && i+1 < argc)      days = std::stoi(argv[++i]);
+        else if(arg == "--seed" && i+1 < argc)      seed = std::stoul(argv[++i]);
+        else if(arg == "--replay" && i+1 < argc)    replayFile = argv[++i];
+        else if(arg == "--paths" && i+1 < argc)     numPaths = std::stoi(argv[++i]);
+        else if(arg == "--stats" && i+1 < argc)     statsFile = argv[++i];
+        else if(arg == "--generate" && i+1 < argc)  generateName = argv[++i];
+        else if(arg == "--roads" && i+1 < argc)     roadSpacing = std::stoul(argv[++i]);
+        else if(arg == "--threads" && i+1 < argc)   numThreads = std::stoul(argv[++i]);
+        else if(arg == "--trace" && i+1 < argc)     traceFile = argv[++i];
+        else if(arg == "--counters")                countEvents = true;
+        else if(arg == "--benchmark" && i+1 < argc) benchmarkFile = argv[++i];
+        else if(arg == "--memory")                  reportMemory = true;
+        else if(arg == "--save" && i+1 < argc)      saveName = argv[++i];
+        else if(arg == "--golden" && i+1 < argc)    goldenFile = argv[++i];
+        else if(arg == "--verify" && i+1 < argc)    verifyFile = argv[++i];
+        else if(arg == "--interval" && i+1 < argc)  interval = std::max(std::stoi(argv[++i]), 1);
+        else if(arg == "--check-map" && i+1 < argc) mapRounds = std::stoi(argv[++i]);
+        else if(arg == "--size" && i+1 < argc)
+        {
+            std::string size = argv[++i];
+            std::size_t x = size.find('x');
+            if(x == std::string::npos)
+            {
+                std::cerr << "Error, size must be given as widthxheight" << std::endl;
+                return 1;
+            }
+            generateWidth = std::stoul(size.substr(0, x));
+            generateHeight = std::stoul(size.substr(x+1));
+        }
+        else if(arg == "--kernel" && i+1 < argc)
+        {
+            std::string name = argv[++i];
+            if(name == "scalar")        kernel = KernelMode::SCALAR;
+            else if(name == "exact")    kernel = KernelMode::EXACT;
+            else if(name == "fast")     kernel = KernelMode::FAST;
+            else
+            {
+                std::cerr << "Error, unknown kernel " << name << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                << " [--city name]... [--copies n] [--days n] [--seed n] [--replay file]"
+                << " [--kernel scalar|exact|fast] [--paths n] [--stats file]"
+                << " [--generate name [--size wxh] [--roads n]] [--threads n] [--trace file]"
+                << " [--counters] [--benchmark file] [--memory]"
+                << " [--save name] [--golden file] [--verify file] [--interval n] [--check-map n]" << std::endl;
+            return 1;
+        }
+    }
+
+    /* A generated city is run in place of any other */
+    if(!generateName.empty()) cityNames.assign(1, generateName);
+
+    if(!cityNames.empty()) cityName = cityNames.front();
+    else cityNames.push_back(cityName);
+
+    /* More than one city runs them all in one process instead */
+    bool hosting = cityNames.size() > 1 || copies > 1;
+    if(hosting && (!replayFile.empty() || numPaths > 0 || !statsFile.empty() || !benchmarkFile.empty() ||
+        !saveName.empty() || !goldenFile.empty() || !verifyFile.empty() || mapRounds > 0))
+    {
+        std::cerr << "Error, --replay, --paths, --stats, --benchmark, --save, --golden, --verify and --check-map"
+            << " only work with a single city" << std::endl;
+        return 1;
+    }
+
+    /* A replay carries its own city and seed */
+    Replay replay;
+    if(!replayFile.empty())
+    {
+        if(!replay.load(replayFile)) return 1;
+        cityName = replay.cityName;
+        seed = replay.seed;
+    }
+
+    /* Read the golden record first, so a missing one fails quickly */
+    GoldenRecord golden;
+    if(!verifyFile.empty() && !golden.load(verifyFile)) return 1;
+
+    /* Keep the most recent events of a long run */
+    if(!traceFile.empty())
+    {
+        tracer.filename = traceFile;
+        tracer.start(1 << 20);
+    }
+
+    Game game(true);
+    if(numThreads != 0) game.threadPool.resize(numThreads);
+
+    if(!generateName.empty())
+    {
+        CityGenerator generator(generateWidth, generateHeight, seed);
+        generator.roadSpacing = roadSpacing;
+        sf::Clock clock;
+        if(!generator.save(generateName, game.threadPool)) return 1;
+        std::cout << "Generated " << generateWidth << "x" << generateHeight << " city " << generateName
+            << " in " << clock.getElapsedTime().asSeconds() << "s" << std::endl;
+        if(days == 0) return 0;
+    }
+
+    if(hosting)
+    {
+        if(countEvents && !counters.start()) return 1;
+        return runHost(game, cityNames, copies, days, seed, kernel);
+    }
+
+    City city(cityName, game.tileSize, game.tileAtlas);
+    city.growthKernel = kernel;
+    city.random.seed(seed);
+    city.shuffleTiles();
+    /* Only the routes use the C library's random numbers */
+    std::srand(seed);
+
+    /* Only the simulated days are counted */
+    if(countEvents && !counters.start()) return 1;
+
+    int startDay = city.day;
+    bool sampling = !goldenFile.empty() || !verifyFile.empty();
+    GoldenRecord record;
+    sf::Clock clock;
+
+    if(!replayFile.empty())
+    {
+        while(true)
+        {
+            replay.apply(city, game.tileAtlas);
+            if(replay.finished(city)) break;
+            city.simulateDay();
+            if(sampling && (city.day - startDay) % interval == 0) record.add(city);
+        }
+    }
+    else
+    {
+        for(int i = 0; i < days; ++i)
+        {
+            city.simulateDay();
+            if(sampling && (city.day - startDay) % interval == 0) record.add(city);
+        }
+    }
+
+    float elapsed = clock.getElapsedTime().asSeconds();
+    days = city.day - startDay;
+
+    /* The last day is always sampled */
+    if(sampling && (record.samples.empty() || record.samples.back().day != city.day)) record.add(city);
+
+    std::cout << "Simulated " << days << " days in " << elapsed << "s ("
+        << days / elapsed << " days/s, " << simdInstructionSet() << " growth kernel)" << std::endl;
+    std::cout << "Day " << city.day
+        << ": population " << long(city.population) << " (" << long(city.getHomeless()) << " homeless)"
+        << ", employable " << long(city.employable) << " (" << long(city.getUnemployed()) << " unemployed)"
+        << ", funds $" << long(city.funds) << std::endl;
+
+    if(counters.enabled) counters.print(std::cout, days, "day");
+
+    MemoryReport memory;
+    city.getMemory(memory);
+    memory.add("textures", game.texmgr.getResidentBytes());
+    if(reportMemory)
+    {
+        memory.print(std::cout);
+        std::cout << double(memory.getTotal()) / city.map.tiles.size() << " bytes per tile" << std::endl;
+    }
+
+    if(!benchmarkFile.empty() && !writeBenchmark(benchmarkFile, cityName, city, days, elapsed,
+        game.threadPool.getNumThreads(), memory)) return 1;
+    counters.stop();
+
+    if(!saveName.empty()) city.save(saveName);
+
+    if(!statsFile.empty())
+    {
+        bool json = statsFile.size() >= 5 && statsFile.compare(statsFile.size()-5, 5, ".json") == 0;
+        if(!(json ? city.stats.exportJSON(statsFile) : city.stats.exportCSV(statsFile))) return 1;
+    }
+
+    if(numPaths > 0)
+    {
+        std::vector<int> roads;
+        for(int pos = 0; pos < city.map.tiles.size(); ++pos)
+        {
+            if(city.map.tiles[pos].tileType == TileType::ROAD) roads.push_back(pos);
+        }
+        if(roads.empty())
+        {
+            std::cerr << "Error, the city has no roads to route along" << std::endl;
+            return 1;
+        }
+
+        std::vector<PathQuery> queries;
+        for(int i = 0; i < numPaths; ++i)
+        {
+            queries.push_back(PathQuery(roads[std::rand() % roads.size()], roads[std::rand() % roads.size()]));
+        }
+
+        /* Build the clusters first so only the queries are timed */
+        city.pathfinder.refresh(city.map);
+        clock.restart();
+        city.pathfinder.findPaths(city.map, queries, game.threadPool);
+        elapsed = clock.getElapsedTime().asSeconds();
+
+        int found = 0;
+        for(auto& query : queries) if(query.length >= 0) ++found;
+        std::cout << "Found " << found << " of " << numPaths << " routes in " << elapsed << "s ("
+            << numPaths / elapsed << " routes/s, " << game.threadPool.getNumThreads() << " threads)" << std::endl;
+    }
+
+    if(!goldenFile.empty())
+    {
+        if(!record.save(goldenFile)) return 1;
+        std::cout << "Wrote " << record.samples.size() << " samples to " << goldenFile << std::endl;
+    }
+
+    if(!verifyFile.empty())
+    {
+        if(!record.compare(golden, std::cerr))
+        {
+            std::cerr << "Error, the city no longer matches " << verifyFile << std::endl;
+            return 1;
+        }
+        std::cout << "Matched all " << golden.samples.size() << " samples in " << verifyFile << std::endl;
+    }
+
+    if(mapRounds > 0)
+    {
+        if(!checkMap(city.map, City::regionTiles, mapRounds, seed, std::cerr))
+        {
+            std::cerr << "Error, the map's optimised functions disagree with the plain ones" << std::endl;
+            return 1;
+        }
+        std::cout << "Map functions agreed over " << mapRounds << " edits" << std::endl;
+    }
+
+    return 0;
+}
@@ -1,12 +1,64 @@
+#include <iostream>
+#include <string>
+#include <algorithm>
+
 #include "game.hpp"
+#include "game_state_loading.hpp"
 #include "game_state_start.hpp"
+#include "game_state_editor.hpp"
+#include "trace.hpp"
+#include "perf_counters.hpp"
 
-int main()
+int main(int argc, char* argv[])
 {
     Game game;
 
-    game.pushState(new GameStateStart(&game));
+    std::string replayFile;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        /* Play back a recorded session */
+        if(arg == "--replay" && i+1 < argc)                 replayFile = argv[++i];
+        /* Limit the texture memory used, in MiB */
+        else if(arg == "--texture-budget" && i+1 < argc)    game.texmgr.budget = std::stoul(argv[++i]) << 20;
+        /* Threads to split work across, or 0 for one per core */
+        else if(arg == "--threads" && i+1 < argc)           game.threadPool.resize(std::stoul(argv[++i]));
+        /* Write a trace of the whole session when the game exits */
+        else if(arg == "--trace" && i+1 < argc)
+        {
+            tracer.filename = argv[++i];
+            tracer.start(1 << 20);
+        }
+        /* Keep a trace of the last few seconds, written by Ctrl+T */
+        else if(arg == "--flight-recorder" && i+1 < argc)   tracer.start(1 << 16, std::stod(argv[++i]));
+        /* Count hardware events in each frame and pass */
+        else if(arg == "--counters")
+        {
+            if(!counters.start()) return 1;
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                << " [--replay file] [--texture-budget MiB] [--threads n]"
+                << " [--trace file | --flight-recorder seconds] [--counters]" << std::endl;
+            return 1;
+        }
+    }
+
+    /* Show a loading screen until the assets needed by the first
+     * state are available */
+    game.pushState(new GameStateLoading(&game, [&game, replayFile]() -> GameState*
+    {
+        if(!replayFile.empty()) return new GameStateEditor(&game, replayFile);
+        return new GameStateStart(&game);
+    }));
     game.gameLoop();
 
+    if(counters.enabled)
+    {
+        auto totals = counters.getTotals();
+        counters.print(std::cout, std::max<double>(totals["frame"].calls, 1), "frame");
+    }
+
     return 0;
 }
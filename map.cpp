@@ -4,75 +4,76 @@
 #include <vector>
 #include <fstream>
 #include <algorithm>
+#include <iterator>
 
 #include "map.hpp"
 #include "tile.hpp"
+#include "trace.hpp"
 
 /* Load map from disk */
 void Map::load(const std::string& filename, unsigned int width, unsigned int height,
-    std::map<std::string, Tile>& tileAtlas)
+    TileAtlas& tileAtlas)
 {
+    TraceZone zone("Map::load");
     std::ifstream inputFile;
     inputFile.open(filename, std::ios::in | std::ios::binary);
 
     this->width = width;
     this->height = height;
+    this->tileAtlas = &tileAtlas;
 
     for(int pos = 0; pos < this->width * this->height; ++pos)
     {
         this->resources.push_back(255);
-		this->selected.push_back(0);
 		
         TileType tileType;
         inputFile.read((char*)&tileType, sizeof(int));
         switch(tileType)
         {
-            default:
-            case TileType::VOID:
             case TileType::GRASS:
-                this->tiles.push_back(tileAtlas.at("grass"));
-                break;
             case TileType::FOREST:
-                this->tiles.push_back(tileAtlas.at("forest"));
-                break;
             case TileType::WATER:
-                this->tiles.push_back(tileAtlas.at("water"));
-                break;
             case TileType::RESIDENTIAL:
-                this->tiles.push_back(tileAtlas.at("residential"));
-                break;
             case TileType::COMMERCIAL:
-                this->tiles.push_back(tileAtlas.at("commercial"));
-                break;
             case TileType::INDUSTRIAL:
-                this->tiles.push_back(tileAtlas.at("industrial"));
-                break;
             case TileType::ROAD:
-                this->tiles.push_back(tileAtlas.at("road"));
+                break;
+            default:
+            case TileType::VOID:
+                tileType = TileType::GRASS;
                 break;
         }
+        this->tiles.push_back(Tile(tileType));
         Tile& tile = this->tiles.back();
         inputFile.read((char*)&tile.tileVariant, sizeof(int));
+        /* Only the transport regions are stored, the rest are
+         * recalculated once the city is loaded */
         inputFile.read((char*)&tile.regions, sizeof(int)*1);
         inputFile.read((char*)&tile.population, sizeof(double));
         inputFile.read((char*)&tile.storedGoods, sizeof(float));
+
+        int zone = zoneIndex(tileType);
+        if(zone >= 0) this->zoneTiles[zone].push_back(pos);
     }
 
     inputFile.close();
 
+    this->selected.resize(this->width, this->height);
+
     return;
 }
 
 void Map::save(const std::string& filename)
 {
+    TraceZone zone("Map::save");
     std::ofstream outputFile;
     outputFile.open(filename, std::ios::out | std::ios::binary);
 
-    for(auto tile : this->tiles)
+    for(auto& tile : this->tiles)
     {
         outputFile.write((char*)&tile.tileType, sizeof(int));
         outputFile.write((char*)&tile.tileVariant, sizeof(int));
-        outputFile.write((char*)&tile.regions, sizeof(int)*3);
+        outputFile.write((char*)&tile.regions, sizeof(int)*1);
         outputFile.write((char*)&tile.population, sizeof(double));
         outputFile.write((char*)&tile.storedGoods, sizeof(float));
     }
@@ -82,156 +83,387 @@ void Map::save(const std::string& filename)
     return;
 }
 
-void Map::draw(sf::RenderWindow& window, float dt)
+void Map::setTile(int pos, const Tile& tile)
+{
+    int oldZone = zoneIndex(this->tiles[pos].tileType);
+    int newZone = zoneIndex(tile.tileType);
+
+    this->tiles[pos] = tile;
+    if(oldZone == newZone) return;
+
+    /* Binary search keeps the zone lists in map order */
+    if(oldZone >= 0)
+    {
+        std::vector<int>& zone = this->zoneTiles[oldZone];
+        zone.erase(std::lower_bound(zone.begin(), zone.end(), pos));
+    }
+    if(newZone >= 0)
+    {
+        std::vector<int>& zone = this->zoneTiles[newZone];
+        zone.insert(std::lower_bound(zone.begin(), zone.end(), pos), pos);
+    }
+
+    return;
+}
+
+void Map::setTiles(const std::vector<int>& positions, const std::vector<Tile>& tiles)
+{
+    std::vector<int> removed[3];
+    std::vector<int> added[3];
+    for(unsigned int i = 0; i < positions.size(); ++i)
+    {
+        int pos = positions[i];
+        int oldZone = zoneIndex(this->tiles[pos].tileType);
+        int newZone = zoneIndex(tiles[i].tileType);
+
+        this->tiles[pos] = tiles[i];
+        if(oldZone == newZone) continue;
+        if(oldZone >= 0) removed[oldZone].push_back(pos);
+        if(newZone >= 0) added[newZone].push_back(pos);
+    }
+
+    /* A single pass over each zone list that changed keeps it in map
+     * order, rather than shifting it once per tile */
+    for(int zone = 0; zone < 3; ++zone)
+    {
+        if(removed[zone].empty() && added[zone].empty()) continue;
+
+        std::sort(removed[zone].begin(), removed[zone].end());
+        std::sort(added[zone].begin(), added[zone].end());
+        std::vector<int> kept;
+        kept.reserve(this->zoneTiles[zone].size() - removed[zone].size());
+        std::set_difference(this->zoneTiles[zone].begin(), this->zoneTiles[zone].end(),
+            removed[zone].begin(), removed[zone].end(), std::back_inserter(kept));
+
+        this->zoneTiles[zone].resize(kept.size() + added[zone].size());
+        std::merge(kept.begin(), kept.end(), added[zone].begin(), added[zone].end(),
+            this->zoneTiles[zone].begin());
+    }
+
+    return;
+}
+
+void Map::draw(sf::RenderWindow& window, TextureManager& texmgr, float dt)
 {
+    TraceZone zone("Map::draw");
+    /* Tiles of the same type share a sprite and animation, so they only
+     * need updating once per frame */
+    this->tileAtlas->update(texmgr, dt);
+
     for(int y = 0; y < this->height; ++y)
     {
         for(int x = 0; x < this->width; ++x)
         {
+            const Tile& tile = this->tiles[y*this->width+x];
+            TilePrototype& prototype = (*this->tileAtlas)[tile.tileType];
+
             /* Set the position of the tile in the 2d world */
             sf::Vector2f pos;
             pos.x = (x - y) * this->tileSize + this->width * this->tileSize;
             pos.y = (x + y) * this->tileSize * 0.5;
-            this->tiles[y*this->width+x].sprite.setPosition(pos);
+            prototype.sprite.setPosition(pos);
 
 			/* Change the colour if the tile is selected */
-			if(this->selected[y*this->width+x])
-				this->tiles[y*this->width+x].sprite.setColor(sf::Color(0x7d, 0x7d, 0x7d));
+			if(this->selected.isMarked(x, y))
+				prototype.sprite.setColor(sf::Color(0x7d, 0x7d, 0x7d));
 			else
-				this->tiles[y*this->width+x].sprite.setColor(sf::Color(0xff, 0xff, 0xff));
+				prototype.sprite.setColor(sf::Color(0xff, 0xff, 0xff));
 
 			/* Draw the tile */
-			this->tiles[y*this->width+x].draw(window, dt);
+			prototype.draw(window, tile);
         }
     }
     return;
 }
 
+void Map::updateDirection(TileType tileType, int x, int y)
+{
+    int pos = y*this->width+x;
+
+    if(this->tiles[pos].tileType != tileType) return;
+
+    bool adjacentTiles[3][3] = {{0,0,0},{0,0,0},{0,0,0}};
+
+    /* Check for adjacent tiles of the same type */
+    if(x > 0 && y > 0)
+        adjacentTiles[0][0] = (this->tiles[(y-1)*this->width+(x-1)].tileType == tileType);
+    if(y > 0)
+        adjacentTiles[0][1] = (this->tiles[(y-1)*this->width+(x  )].tileType == tileType);
+    if(x < this->width-1 && y > 0)
+        adjacentTiles[0][2] = (this->tiles[(y-1)*this->width+(x+1)].tileType == tileType);
+    if(x > 0)
+        adjacentTiles[1][0] = (this->tiles[(y  )*this->width+(x-1)].tileType == tileType);
+    if(x < width-1)
+        adjacentTiles[1][2] = (this->tiles[(y  )*this->width+(x+1)].tileType == tileType);
+    if(x > 0 && y < this->height-1)
+        adjacentTiles[2][0] = (this->tiles[(y+1)*this->width+(x-1)].tileType == tileType);
+    if(y < this->height-1)
+        adjacentTiles[2][1] = (this->tiles[(y+1)*this->width+(x  )].tileType == tileType);
+    if(x < this->width-1 && y < this->height-1)
+        adjacentTiles[2][2] = (this->tiles[(y+1)*this->width+(x+1)].tileType == tileType);
+
+    /* Change the tile variant depending on the tile position */
+    if(adjacentTiles[1][0] && adjacentTiles[1][2] && adjacentTiles[0][1] && adjacentTiles[2][1])
+        this->tiles[pos].tileVariant = 2;
+    else if(adjacentTiles[1][0] && adjacentTiles[1][2] && adjacentTiles[0][1])
+        this->tiles[pos].tileVariant = 7;
+    else if(adjacentTiles[1][0] && adjacentTiles[1][2] && adjacentTiles[2][1])
+        this->tiles[pos].tileVariant = 8;
+    else if(adjacentTiles[0][1] && adjacentTiles[2][1] && adjacentTiles[1][0])
+        this->tiles[pos].tileVariant = 9;
+    else if(adjacentTiles[0][1] && adjacentTiles[2][1] && adjacentTiles[1][2])
+        this->tiles[pos].tileVariant = 10;
+    else if(adjacentTiles[1][0] && adjacentTiles[1][2])
+        this->tiles[pos].tileVariant = 0;
+    else if(adjacentTiles[0][1] && adjacentTiles[2][1])
+        this->tiles[pos].tileVariant = 1;
+    else if(adjacentTiles[2][1] && adjacentTiles[1][0])
+        this->tiles[pos].tileVariant = 3;
+    else if(adjacentTiles[0][1] && adjacentTiles[1][2])
+        this->tiles[pos].tileVariant = 4;
+    else if(adjacentTiles[1][0] && adjacentTiles[0][1])
+        this->tiles[pos].tileVariant = 5;
+    else if(adjacentTiles[2][1] && adjacentTiles[1][2])
+        this->tiles[pos].tileVariant = 6;
+    else if(adjacentTiles[1][0])
+        this->tiles[pos].tileVariant = 0;
+    else if(adjacentTiles[1][2])
+        this->tiles[pos].tileVariant = 0;
+    else if(adjacentTiles[0][1])    
+        this->tiles[pos].tileVariant = 1;
+    else if(adjacentTiles[2][1])
+        this->tiles[pos].tileVariant = 1;
+
+    return;
+}
+
 void Map::updateDirection(TileType tileType)
 {
     for(int y = 0; y < this->height; ++y)
     {
         for(int x = 0; x < this->width; ++x)
         {
-            int pos = y*this->width+x;
+            this->updateDirection(tileType, x, y);
+        }
+    }
+
+    return;
+}
 
-            if(this->tiles[pos].tileType != tileType) continue;
-
-            bool adjacentTiles[3][3] = {{0,0,0},{0,0,0},{0,0,0}};
-
-            /* Check for adjacent tiles of the same type */
-            if(x > 0 && y > 0)
-                adjacentTiles[0][0] = (this->tiles[(y-1)*this->width+(x-1)].tileType == tileType);
-            if(y > 0)
-                adjacentTiles[0][1] = (this->tiles[(y-1)*this->width+(x  )].tileType == tileType);
-            if(x < this->width-1 && y > 0)
-                adjacentTiles[0][2] = (this->tiles[(y-1)*this->width+(x+1)].tileType == tileType);
-            if(x > 0)
-                adjacentTiles[1][0] = (this->tiles[(y  )*this->width+(x-1)].tileType == tileType);
-            if(x < width-1)
-                adjacentTiles[1][2] = (this->tiles[(y  )*this->width+(x+1)].tileType == tileType);
-            if(x > 0 && y < this->height-1)
-                adjacentTiles[2][0] = (this->tiles[(y+1)*this->width+(x-1)].tileType == tileType);
-            if(y < this->height-1)
-                adjacentTiles[2][1] = (this->tiles[(y+1)*this->width+(x  )].tileType == tileType);
-            if(x < this->width-1 && y < this->height-1)
-                adjacentTiles[2][2] = (this->tiles[(y+1)*this->width+(x+1)].tileType == tileType);
-
-            /* Change the tile variant depending on the tile position */
-            if(adjacentTiles[1][0] && adjacentTiles[1][2] && adjacentTiles[0][1] && adjacentTiles[2][1])
-                this->tiles[pos].tileVariant = 2;
-            else if(adjacentTiles[1][0] && adjacentTiles[1][2] && adjacentTiles[0][1])
-                this->tiles[pos].tileVariant = 7;
-            else if(adjacentTiles[1][0] && adjacentTiles[1][2] && adjacentTiles[2][1])
-                this->tiles[pos].tileVariant = 8;
-            else if(adjacentTiles[0][1] && adjacentTiles[2][1] && adjacentTiles[1][0])
-                this->tiles[pos].tileVariant = 9;
-            else if(adjacentTiles[0][1] && adjacentTiles[2][1] && adjacentTiles[1][2])
-                this->tiles[pos].tileVariant = 10;
-            else if(adjacentTiles[1][0] && adjacentTiles[1][2])
-                this->tiles[pos].tileVariant = 0;
-            else if(adjacentTiles[0][1] && adjacentTiles[2][1])
-                this->tiles[pos].tileVariant = 1;
-            else if(adjacentTiles[2][1] && adjacentTiles[1][0])
-                this->tiles[pos].tileVariant = 3;
-            else if(adjacentTiles[0][1] && adjacentTiles[1][2])
-                this->tiles[pos].tileVariant = 4;
-            else if(adjacentTiles[1][0] && adjacentTiles[0][1])
-                this->tiles[pos].tileVariant = 5;
-            else if(adjacentTiles[2][1] && adjacentTiles[1][2])
-                this->tiles[pos].tileVariant = 6;
-            else if(adjacentTiles[1][0])
-                this->tiles[pos].tileVariant = 0;
-            else if(adjacentTiles[1][2])
-                this->tiles[pos].tileVariant = 0;
-            else if(adjacentTiles[0][1])    
-                this->tiles[pos].tileVariant = 1;
-            else if(adjacentTiles[2][1])
-                this->tiles[pos].tileVariant = 1;
+void Map::updateDirection(TileType tileType, const std::vector<int>& changed)
+{
+    /* A tile's direction only depends on its neighbours */
+    for(int pos : changed)
+    {
+        int x = pos % this->width;
+        int y = pos / this->width;
+        for(int ny = std::max(y-1, 0); ny <= std::min(y+1, int(this->height)-1); ++ny)
+        {
+            for(int nx = std::max(x-1, 0); nx <= std::min(x+1, int(this->width)-1); ++nx)
+            {
+                this->updateDirection(tileType, nx, ny);
+            }
         }
     }
 
     return;
 }
 
-void Map::depthfirstsearch(std::vector<TileType>& whitelist,
+void Map::depthfirstsearch(TileTypeSet whitelist,
     sf::Vector2i pos, int label, int regionType=0)
 {
     if(pos.x < 0 || pos.x >= this->width) return;
     if(pos.y < 0 || pos.y >= this->height) return;
-    if(this->tiles[pos.y*this->width+pos.x].regions[regionType] != 0) return;
-    bool found = false;
-    for(auto type : whitelist)
+
+    /* An explicit stack rather than recursion, since a region can cover
+     * most of a large map */
+    std::vector<int> stack(1, pos.y*this->width+pos.x);
+    while(!stack.empty())
     {
-        if(type == this->tiles[pos.y*this->width+pos.x].tileType)
-        {
-            found = true;
-            break;
-        }
+        int tilePos = stack.back();
+        stack.pop_back();
+        Tile& tile = this->tiles[tilePos];
+        if(tile.regions[regionType] != 0 || !whitelist.contains(tile.tileType)) continue;
+
+        tile.regions[regionType] = label;
+
+        int x = tilePos % this->width;
+        int y = tilePos / this->width;
+        if(x > 0)                   stack.push_back(tilePos-1);
+        if(y < this->height-1)      stack.push_back(tilePos+this->width);
+        if(x < this->width-1)       stack.push_back(tilePos+1);
+        if(y > 0)                   stack.push_back(tilePos-this->width);
     }
-    if(!found) return;
 
-    this->tiles[pos.y*this->width+pos.x].regions[regionType] = label;
+    return;
+}
 
-    depthfirstsearch(whitelist, pos + sf::Vector2i(-1,  0), label, regionType);
-    depthfirstsearch(whitelist, pos + sf::Vector2i(0 ,  1), label, regionType);
-    depthfirstsearch(whitelist, pos + sf::Vector2i(1 ,  0), label, regionType);
-    depthfirstsearch(whitelist, pos + sf::Vector2i(0 , -1), label, regionType);
+void Map::findConnectedRegions(std::vector<TileType> whitelist, int regionType=0)
+{
+    this->findConnectedRegions(TileTypeSet(whitelist), regionType);
 
     return;
 }
 
-void Map::findConnectedRegions(std::vector<TileType> whitelist, int regionType=0)
+void Map::findConnectedRegions(TileTypeSet whitelist, int regionType=0)
 {
-    int regions = 1;
+    this->findConnectedRegions(&whitelist, regionType, 1);
 
-    for(auto& tile : this->tiles) tile.regions[regionType] = 0;
+    return;
+}
+
+/* Root of the tree containing pos, halving the path to it on the way */
+static int findRoot(std::vector<int>& parents, int pos)
+{
+    while(parents[pos] != pos)
+    {
+        parents[pos] = parents[parents[pos]];
+        pos = parents[pos];
+    }
+
+    return pos;
+}
+
+static void join(std::vector<int>& parents, int a, int b)
+{
+    a = findRoot(parents, a);
+    b = findRoot(parents, b);
+    /* Keep the earliest tile as the root */
+    if(a < b) parents[b] = a;
+    else if(b < a) parents[a] = b;
+
+    return;
+}
+
+void Map::findConnectedRegions(const TileTypeSet* whitelists, int firstType, int numTypes)
+{
+    TraceZone zone("Map::findConnectedRegions");
+    int size = this->width * this->height;
+    std::vector<std::vector<int>> parents(numTypes, std::vector<int>(size));
 
+    /* Join every tile to the tiles left of and above it in each layer
+     * that connects them */
     for(int y = 0; y < this->height; ++y)
     {
         for(int x = 0; x < this->width; ++x)
         {
-            bool found = false;
-            for(auto type : whitelist)
+            int pos = y*this->width+x;
+            TileType tileType = this->tiles[pos].tileType;
+            TileType left = x > 0 ? this->tiles[pos-1].tileType : TileType::VOID;
+            TileType up = y > 0 ? this->tiles[pos-this->width].tileType : TileType::VOID;
+            for(int i = 0; i < numTypes; ++i)
             {
-                if(type == this->tiles[y*this->width+x].tileType)
-                {
-                    found = true;
-                    break;
-                }
+                parents[i][pos] = pos;
+                if(!whitelists[i].contains(tileType)) continue;
+                if(x > 0 && whitelists[i].contains(left)) join(parents[i], pos, pos-1);
+                if(y > 0 && whitelists[i].contains(up)) join(parents[i], pos, pos-this->width);
             }
-            if(this->tiles[y*this->width+x].regions[regionType] == 0 && found)
+        }
+    }
+
+    /* Number the regions in the order their first tiles appear. A root
+     * is always the first tile of its region, so it is labelled before
+     * the rest of the region looks it up */
+    std::vector<unsigned int> regions(numTypes, 1);
+    std::vector<std::vector<unsigned int>> labels(numTypes, std::vector<unsigned int>(size, 0));
+    for(int pos = 0; pos < size; ++pos)
+    {
+        Tile& tile = this->tiles[pos];
+        for(int i = 0; i < numTypes; ++i)
+        {
+            unsigned int label = 0;
+            if(whitelists[i].contains(tile.tileType))
             {
-                depthfirstsearch(whitelist, sf::Vector2i(x, y), regions++, regionType);
+                int root = findRoot(parents[i], pos);
+                if(root == pos) labels[i][pos] = regions[i]++;
+                label = labels[i][root];
             }
+            tile.regions[firstType+i] = label;
         }
     }
-    this->numRegions[regionType] = regions;
+    for(int i = 0; i < numTypes; ++i) this->numRegions[firstType+i] = regions[i];
+
+    return;
+}
+
+void Map::updateConnectedRegions(TileTypeSet whitelist, int regionType,
+    const std::vector<int>& changed)
+{
+    TraceZone zone("Map::updateConnectedRegions");
+    const sf::Vector2i offsets[4] = { {-1, 0}, {0, 1}, {1, 0}, {0, -1} };
+
+    /* Only regions touching a changed tile can merge or split. Collect
+     * their labels and every tile that may need a new one */
+    std::vector<unsigned int> labels;
+    std::vector<int> seeds;
+    for(int pos : changed)
+    {
+        sf::Vector2i tilePos(pos % this->width, pos / this->width);
+        seeds.push_back(pos);
+        this->tiles[pos].regions[regionType] = 0;
+        for(auto offset : offsets)
+        {
+            sf::Vector2i n = tilePos + offset;
+            if(n.x < 0 || n.x >= this->width || n.y < 0 || n.y >= this->height) continue;
+            int npos = n.y*this->width+n.x;
+            unsigned int label = this->tiles[npos].regions[regionType];
+            seeds.push_back(npos);
+            if(label != 0 && std::find(labels.begin(), labels.end(), label) == labels.end())
+                labels.push_back(label);
+        }
+    }
+
+    /* Unlabel those regions. Every part of a region that has split
+     * still touches a changed tile, so is reached from the seeds */
+    std::vector<int> stack = seeds;
+    while(!stack.empty())
+    {
+        int pos = stack.back();
+        stack.pop_back();
+        sf::Vector2i tilePos(pos % this->width, pos / this->width);
+        for(auto offset : offsets)
+        {
+            sf::Vector2i n = tilePos + offset;
+            if(n.x < 0 || n.x >= this->width || n.y < 0 || n.y >= this->height) continue;
+            int npos = n.y*this->width+n.x;
+            unsigned int label = this->tiles[npos].regions[regionType];
+            if(label != 0 && std::find(labels.begin(), labels.end(), label) != labels.end())
+            {
+                this->tiles[npos].regions[regionType] = 0;
+                stack.push_back(npos);
+            }
+        }
+        unsigned int label = this->tiles[pos].regions[regionType];
+        if(label != 0 && std::find(labels.begin(), labels.end(), label) != labels.end())
+            this->tiles[pos].regions[regionType] = 0;
+    }
+
+    /* Label them again, reusing the old labels before making new ones */
+    for(int pos : seeds)
+    {
+        if(this->tiles[pos].regions[regionType] != 0 ||
+            !whitelist.contains(this->tiles[pos].tileType)) continue;
+
+        unsigned int label;
+        if(!labels.empty())
+        {
+            label = labels.back();
+            labels.pop_back();
+        }
+        else
+        {
+            label = this->numRegions[regionType]++;
+        }
+        depthfirstsearch(whitelist, sf::Vector2i(pos % this->width, pos / this->width),
+            label, regionType);
+    }
+
+    return;
 }
 
 void Map::clearSelected()
 {
-    for(auto& tile : this->selected) tile = 0;
+    this->selected.clear();
 
     this->numSelected = 0;
 
@@ -239,6 +471,21 @@ void Map::clearSelected()
 }
 
 void Map::select(sf::Vector2i start, sf::Vector2i end, std::vector<TileType> blacklist)
+{
+    this->select(start, end, TileTypeSet(blacklist));
+
+    return;
+}
+
+void Map::select(sf::Vector2i start, sf::Vector2i end, TileTypeSet blacklist)
+{
+    this->select(this->selected, start, end, blacklist);
+    this->numSelected = this->selected.count();
+
+    return;
+}
+
+void Map::select(Selection& selection, sf::Vector2i start, sf::Vector2i end, TileTypeSet blacklist) const
 {
     /* Swap coordinates if necessary */
     if(end.y < start.y) std::swap(start.y, end.y);
@@ -260,17 +507,7 @@ void Map::select(sf::Vector2i start, sf::Vector2i end, std::vector<TileType> bla
         {
             /* Check if the tile type is in the blacklist. If it is, mark it as
              * invalid, otherwise select it */
-            this->selected[y*this->width+x] = 1;
-            ++this->numSelected;
-            for(auto type : blacklist)
-            {
-                if(this->tiles[y*this->width+x].tileType == type)
-                {
-                    this->selected[y*this->width+x] = 2;
-                    --this->numSelected;
-                    break;
-                }
-            }
+            selection.mark(x, y, !blacklist.contains(this->tiles[y*this->width+x].tileType));
         }
     }
 
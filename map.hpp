@@ -8,14 +8,21 @@
 #include <vector>
 
 #include "tile.hpp"
+#include "texture_manager.hpp"
+#include "selection.hpp"
+#include "road_network.hpp"
 
 class Map
 {
     private:
 
-    void depthfirstsearch(std::vector<TileType>& whitelist,
+    /* Label every unlabelled tile in the whitelist connected to pos */
+    void depthfirstsearch(TileTypeSet whitelist,
         sf::Vector2i pos, int label, int type);
 
+    /* Update the direction of a single tile */
+    void updateDirection(TileType tileType, int x, int y);
+
     public:
 
     unsigned int width;
@@ -23,40 +30,91 @@ class Map
 
     std::vector<Tile> tiles;
 
+    /* Prototypes of the tiles' types */
+    TileAtlas* tileAtlas;
+
     /* Resource map */
     std::vector<int> resources;
 
+    /* Indices of the residential, commercial and industrial tiles, each
+     * kept in map order, so that the simulation can skip undeveloped
+     * land. Indexed by zoneIndex() */
+    std::vector<int> zoneTiles[3];
+
+    /* Index of a zone type in zoneTiles, or -1 if the type is not a zone */
+    static int zoneIndex(TileType tileType)
+    {
+        switch(tileType)
+        {
+            case TileType::RESIDENTIAL: return 0;
+            case TileType::COMMERCIAL:  return 1;
+            case TileType::INDUSTRIAL:  return 2;
+            default:                    return -1;
+        }
+    }
+
     unsigned int tileSize;
 
-    unsigned int numRegions[1];
+    unsigned int numRegions[numRegionTypes];
 
-	/* 0 = Deselected, 1 = Selected, 2 = Invalid */
-	std::vector<char> selected;
+    /* Graph of the road tiles, kept up to date by City::tileChanged */
+    RoadNetwork roads;
+
+	/* Selected tiles, and tiles that could not be selected */
+	Selection selected;
 	unsigned int numSelected;
 
 	/* Select the tiles within the bounds */
 	void select(sf::Vector2i start, sf::Vector2i end, std::vector<TileType> blacklist);
+	void select(sf::Vector2i start, sf::Vector2i end, TileTypeSet blacklist);
+	/* Mark the tiles within the bounds in another selection, leaving
+	 * the map's own untouched */
+	void select(Selection& selection, sf::Vector2i start, sf::Vector2i end, TileTypeSet blacklist) const;
 
 	/* Deselect all tiles */
 	void clearSelected();
 
     /* Load map from disk */
     void load(const std::string& filename, unsigned int width, unsigned int height,
-        std::map<std::string, Tile>& tileAtlas);
+        TileAtlas& tileAtlas);
 
     /* Save map to disk */
     void save(const std::string& filename);
 
+    /* Replace the tile at pos, keeping the zone index up to date */
+    void setTile(int pos, const Tile& tile);
+    /* Replace the tiles at the given distinct positions, merging the
+     * changes into each zone index at once */
+    void setTiles(const std::vector<int>& positions, const std::vector<Tile>& tiles);
+
     /* Draw the map */    
-    void draw(sf::RenderWindow& window, float dt);
+    void draw(sf::RenderWindow& window, TextureManager& texmgr, float dt);
 
     /* Checks if one position in the map is connected to another by
      * only traversing tiles in the whitelist */
     void findConnectedRegions(std::vector<TileType> whitelist, int type);
+    void findConnectedRegions(TileTypeSet whitelist, int type);
+    /* Label numTypes layers of regions in a single pass over the map,
+     * layer firstType+i connecting the tiles in whitelists[i] */
+    void findConnectedRegions(const TileTypeSet* whitelists, int firstType, int numTypes);
+
+    /* Update the regions after the tiles at the given positions have
+     * changed, relabelling only the regions touching them. Labels are
+     * no longer numbered in map order afterwards */
+    void updateConnectedRegions(TileTypeSet whitelist, int type,
+        const std::vector<int>& changed);
 
     /* Update the direction of directional tiles so that they face the correct
      * way. Used to orient roads, pylons, rivers etc */
     void updateDirection(TileType tileType);
+    /* Only update the tiles around the given positions */
+    void updateDirection(TileType tileType, const std::vector<int>& changed);
+
+    /* Data shared by every tile of the tile's type */
+    const TilePrototype& getPrototype(const Tile& tile) const
+    {
+        return (*this->tileAtlas)[tile.tileType];
+    }
     
 	/* Blank map constructor */
 	Map()
@@ -65,11 +123,12 @@ class Map
 		this->tileSize = 8;
 		this->width = 0;
 		this->height = 0;
-		this->numRegions[0] = 1;
+		for(auto& regions : this->numRegions) regions = 1;
+		this->tileAtlas = nullptr;
 	}
 	/* Load map from file constructor */
 	Map(const std::string& filename, unsigned int width, unsigned int height,
-		std::map<std::string, Tile>& tileAtlas)
+		TileAtlas& tileAtlas)
 	{
 		this->numSelected = 0;
 		this->tileSize = 8;
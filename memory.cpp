@@ -0,0 +1,60 @@
+#include <string>
+#include <vector>
+#include <ostream>
+#include <sstream>
+#include <iomanip>
+
+#include "memory.hpp"
+
+std::size_t MemoryReport::getTotal() const
+{
+    std::size_t total = 0;
+    for(auto& entry : this->entries) total += entry.second;
+
+    return total;
+}
+
+void MemoryReport::print(std::ostream& out) const
+{
+    out << "Memory used:" << std::endl;
+    for(auto& entry : this->entries)
+    {
+        out << "  " << std::left << std::setw(24) << entry.first << std::right
+            << std::setw(12) << MemoryReport::format(entry.second) << std::endl;
+    }
+    out << "  " << std::left << std::setw(24) << "total" << std::right
+        << std::setw(12) << MemoryReport::format(this->getTotal()) << std::endl;
+
+    return;
+}
+
+void MemoryReport::printJSON(std::ostream& out) const
+{
+    out << "{";
+    for(unsigned int i = 0; i < this->entries.size(); ++i)
+    {
+        out << (i > 0 ? "," : "") << std::endl
+            << "    \"" << this->entries[i].first << "\": " << this->entries[i].second;
+    }
+    out << std::endl << "  }";
+
+    return;
+}
+
+std::string MemoryReport::format(std::size_t bytes)
+{
+    static const char* units[] = { "B", "KiB", "MiB", "GiB" };
+
+    double size = bytes;
+    int unit = 0;
+    while(size >= 1024 && unit < 3)
+    {
+        size /= 1024;
+        ++unit;
+    }
+
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << size << " " << units[unit];
+
+    return stream.str();
+}
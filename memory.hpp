@@ -0,0 +1,47 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <ostream>
+#include <cstddef>
+
+/* Memory reserved by a vector, in bytes */
+template<typename T>
+std::size_t vectorSize(const std::vector<T>& v)
+{
+    return v.capacity() * sizeof(T);
+}
+
+inline std::size_t vectorSize(const std::vector<bool>& v)
+{
+    return v.capacity() / 8;
+}
+
+/* Bytes used by each part of the game, so that it is clear where the
+ * memory goes and a change that uses more of it per tile stands out */
+class MemoryReport
+{
+    public:
+
+    std::vector<std::pair<std::string, std::size_t>> entries;
+
+    void add(const std::string& name, std::size_t bytes)
+    {
+        this->entries.push_back(std::make_pair(name, bytes));
+    }
+
+    std::size_t getTotal() const;
+
+    /* Write a table of the entries and their total */
+    void print(std::ostream& out) const;
+
+    /* Write the entries as a JSON object */
+    void printJSON(std::ostream& out) const;
+
+    /* Bytes as a short string such as "1.5 MiB" */
+    static std::string format(std::size_t bytes);
+};
+
+#endif /* MEMORY_HPP */
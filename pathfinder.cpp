@@ -0,0 +1,432 @@
+#include <vector>
+#include <queue>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+
+#include "pathfinder.hpp"
+#include "thread_pool.hpp"
+#include "map.hpp"
+#include "tile.hpp"
+#include "memory.hpp"
+
+typedef std::pair<int, int> QueueEntry;
+typedef std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> OpenSet;
+
+unsigned int Pathfinder::Scratch::begin(unsigned int size)
+{
+    if(this->marks.size() != size)
+    {
+        this->marks.assign(size, 0);
+        this->cost.resize(size);
+        this->parent.resize(size);
+        this->currentMark = 0;
+    }
+    /* Wrapping around would let old marks match */
+    if(++this->currentMark == 0)
+    {
+        std::fill(this->marks.begin(), this->marks.end(), 0);
+        this->currentMark = 1;
+    }
+
+    return this->currentMark;
+}
+
+int Pathfinder::getCluster(int pos) const
+{
+    int x = pos % this->map->width;
+    int y = pos / this->map->width;
+
+    return (y / clusterSize) * this->clustersX + x / clusterSize;
+}
+
+bool Pathfinder::isPassable(int pos) const
+{
+    return this->passable.contains(this->map->tiles[pos].tileType);
+}
+
+int Pathfinder::search(int from, int to, int cluster, Scratch& s, std::vector<int>* path) const
+{
+    const int width = this->map->width;
+    const int height = this->map->height;
+    unsigned int mark = s.begin(this->map->tiles.size());
+    int toX = to % width;
+    int toY = to / width;
+
+    OpenSet open;
+    s.marks[from] = mark;
+    s.cost[from] = 0;
+    s.parent[from] = -1;
+    open.push(QueueEntry(std::abs(from % width - toX) + std::abs(from / width - toY), from));
+
+    while(!open.empty())
+    {
+        QueueEntry entry = open.top();
+        open.pop();
+        int pos = entry.second;
+        int x = pos % width;
+        int y = pos / width;
+        if(entry.first - (std::abs(x - toX) + std::abs(y - toY)) > s.cost[pos]) continue;
+
+        if(pos == to)
+        {
+            if(path != nullptr)
+            {
+                std::size_t start = path->size();
+                for(int p = to; p != from; p = s.parent[p]) path->push_back(p);
+                std::reverse(path->begin() + start, path->end());
+            }
+            return s.cost[to];
+        }
+
+        int around[4] = {
+            x > 0           ? pos-1     : -1,
+            y < height-1    ? pos+width : -1,
+            x < width-1     ? pos+1     : -1,
+            y > 0           ? pos-width : -1 };
+        for(int next : around)
+        {
+            if(next < 0 || !this->isPassable(next)) continue;
+            if(cluster >= 0 && this->getCluster(next) != cluster) continue;
+
+            int cost = s.cost[pos] + 1;
+            if(s.marks[next] == mark && s.cost[next] <= cost) continue;
+
+            s.marks[next] = mark;
+            s.cost[next] = cost;
+            s.parent[next] = pos;
+            open.push(QueueEntry(cost + std::abs(next % width - toX) + std::abs(next / width - toY), next));
+        }
+    }
+
+    return -1;
+}
+
+void Pathfinder::flood(int pos, Scratch& s) const
+{
+    const int width = this->map->width;
+    const int height = this->map->height;
+    unsigned int mark = s.begin(this->map->tiles.size());
+    int cluster = this->getCluster(pos);
+
+    /* parent doubles as the queue, since every tile is queued once */
+    std::vector<int>& queue = s.parent;
+    unsigned int head = 0;
+    unsigned int tail = 0;
+    queue[tail++] = pos;
+    s.marks[pos] = mark;
+    s.cost[pos] = 0;
+
+    while(head < tail)
+    {
+        int current = queue[head++];
+        int x = current % width;
+        int y = current / width;
+        int around[4] = {
+            x > 0           ? current-1     : -1,
+            y < height-1    ? current+width : -1,
+            x < width-1     ? current+1     : -1,
+            y > 0           ? current-width : -1 };
+        for(int next : around)
+        {
+            if(next < 0 || s.marks[next] == mark || !this->isPassable(next)) continue;
+            if(this->getCluster(next) != cluster) continue;
+
+            s.marks[next] = mark;
+            s.cost[next] = s.cost[current] + 1;
+            queue[tail++] = next;
+        }
+    }
+
+    return;
+}
+
+void Pathfinder::rebuildCluster(int cluster)
+{
+    Cluster& c = this->clusters[cluster];
+    const int width = this->map->width;
+    const int height = this->map->height;
+
+    for(int pos : c.entrances) this->entranceIndex[pos] = -1;
+    c.entrances.clear();
+
+    int x0 = (cluster % this->clustersX) * clusterSize;
+    int y0 = (cluster / this->clustersX) * clusterSize;
+    int x1 = std::min(x0 + clusterSize, width) - 1;
+    int y1 = std::min(y0 + clusterSize, height) - 1;
+
+    /* Place an entrance in the middle of every run of tiles that can
+     * cross a side. The cluster on the other side finds the same runs,
+     * so its entrances always face these */
+    auto addSide = [&](int inside, int step, int outside, int length)
+    {
+        int runStart = -1;
+        for(int i = 0; i <= length; ++i)
+        {
+            bool open = i < length &&
+                this->isPassable(inside + i*step) && this->isPassable(outside + i*step);
+            if(open && runStart < 0) runStart = i;
+            if(!open && runStart >= 0)
+            {
+                int pos = inside + ((runStart + i - 1) / 2) * step;
+                if(std::find(c.entrances.begin(), c.entrances.end(), pos) == c.entrances.end())
+                    c.entrances.push_back(pos);
+                runStart = -1;
+            }
+        }
+    };
+    if(x0 > 0)          addSide(y0*width+x0, width, y0*width+x0-1, y1-y0+1);
+    if(x1 < width-1)    addSide(y0*width+x1, width, y0*width+x1+1, y1-y0+1);
+    if(y0 > 0)          addSide(y0*width+x0, 1, (y0-1)*width+x0, x1-x0+1);
+    if(y1 < height-1)   addSide(y1*width+x0, 1, (y1+1)*width+x0, x1-x0+1);
+
+    unsigned int n = c.entrances.size();
+    for(unsigned int i = 0; i < n; ++i) this->entranceIndex[c.entrances[i]] = i;
+
+    c.distances.assign(n*n, -1);
+    Scratch& s = this->scratch[0];
+    for(unsigned int i = 0; i < n; ++i)
+    {
+        this->flood(c.entrances[i], s);
+        for(unsigned int j = 0; j < n; ++j)
+        {
+            int pos = c.entrances[j];
+            if(s.marks[pos] == s.currentMark) c.distances[i*n+j] = s.cost[pos];
+        }
+    }
+    c.dirty = false;
+
+    return;
+}
+
+void Pathfinder::invalidate(const Map& map, const std::vector<int>& changed)
+{
+    /* A different map is rebuilt from scratch anyway */
+    if(this->map != &map || this->clusters.empty()) return;
+
+    for(int pos : changed)
+    {
+        int x = pos % this->map->width;
+        int y = pos / this->map->width;
+        int cluster = this->getCluster(pos);
+        this->clusters[cluster].dirty = true;
+
+        /* Tiles along a side also decide the neighbour's entrances */
+        if(x % clusterSize == 0 && x > 0)
+            this->clusters[cluster-1].dirty = true;
+        if(x % clusterSize == clusterSize-1 && x < this->map->width-1)
+            this->clusters[cluster+1].dirty = true;
+        if(y % clusterSize == 0 && y > 0)
+            this->clusters[cluster-this->clustersX].dirty = true;
+        if(y % clusterSize == clusterSize-1 && y < this->map->height-1)
+            this->clusters[cluster+this->clustersX].dirty = true;
+    }
+
+    return;
+}
+
+void Pathfinder::invalidateAll()
+{
+    for(auto& cluster : this->clusters) cluster.dirty = true;
+
+    return;
+}
+
+void Pathfinder::refresh(const Map& map)
+{
+    if(this->map != &map || this->entranceIndex.size() != map.tiles.size())
+    {
+        this->map = &map;
+        this->clustersX = (map.width + clusterSize - 1) / clusterSize;
+        this->clustersY = (map.height + clusterSize - 1) / clusterSize;
+        this->clusters.assign(this->clustersX * this->clustersY, Cluster());
+        this->entranceIndex.assign(map.tiles.size(), -1);
+    }
+    if(this->scratch.empty()) this->scratch.resize(1);
+
+    for(int i = 0; i < this->clusters.size(); ++i)
+    {
+        if(this->clusters[i].dirty) this->rebuildCluster(i);
+    }
+
+    return;
+}
+
+void Pathfinder::findPath(PathQuery& query, Scratch& s) const
+{
+    const int width = this->map->width;
+    const int size = this->map->tiles.size();
+    int from = query.from;
+    int to = query.to;
+
+    query.path.clear();
+    query.length = -1;
+    if(from < 0 || from >= size || to < 0 || to >= size) return;
+    if(!this->isPassable(from) || !this->isPassable(to)) return;
+
+    query.path.push_back(from);
+    if(from == to)
+    {
+        query.length = 0;
+        return;
+    }
+
+    int fromCluster = this->getCluster(from);
+    int toCluster = this->getCluster(to);
+
+    /* Routes within a cluster do not need planning */
+    if(fromCluster == toCluster && this->search(from, to, fromCluster, s, &query.path) >= 0)
+    {
+        query.length = query.path.size() - 1;
+        return;
+    }
+
+    /* Distances from the start and goal to their clusters' entrances */
+    const Cluster& start = this->clusters[fromCluster];
+    const Cluster& goal = this->clusters[toCluster];
+    std::vector<int> startCost(start.entrances.size(), -1);
+    std::vector<int> goalCost(goal.entrances.size(), -1);
+    this->flood(from, s);
+    for(int i = 0; i < start.entrances.size(); ++i)
+    {
+        if(s.marks[start.entrances[i]] == s.currentMark) startCost[i] = s.cost[start.entrances[i]];
+    }
+    this->flood(to, s);
+    for(int i = 0; i < goal.entrances.size(); ++i)
+    {
+        if(s.marks[goal.entrances[i]] == s.currentMark) goalCost[i] = s.cost[goal.entrances[i]];
+    }
+
+    /* A* across the entrances, moving either through a cluster or
+     * across to an entrance on the other side */
+    unsigned int mark = s.begin(size);
+    int toX = to % width;
+    int toY = to / width;
+    auto heuristic = [&](int pos) { return std::abs(pos % width - toX) + std::abs(pos / width - toY); };
+    OpenSet open;
+    auto reach = [&](int pos, int cost, int parent)
+    {
+        if(s.marks[pos] == mark && s.cost[pos] <= cost) return;
+        s.marks[pos] = mark;
+        s.cost[pos] = cost;
+        s.parent[pos] = parent;
+        open.push(QueueEntry(cost + heuristic(pos), pos));
+    };
+    for(int i = 0; i < start.entrances.size(); ++i)
+    {
+        if(startCost[i] >= 0) reach(start.entrances[i], startCost[i], -1);
+    }
+
+    int best = std::numeric_limits<int>::max();
+    int bestEntrance = -1;
+    while(!open.empty())
+    {
+        QueueEntry entry = open.top();
+        open.pop();
+        if(entry.first >= best) break;
+        int pos = entry.second;
+        int cost = s.cost[pos];
+        if(entry.first - heuristic(pos) > cost) continue;
+
+        int cluster = this->getCluster(pos);
+        const Cluster& c = this->clusters[cluster];
+        int i = this->entranceIndex[pos];
+        if(cluster == toCluster && goalCost[i] >= 0 && cost + goalCost[i] < best)
+        {
+            best = cost + goalCost[i];
+            bestEntrance = pos;
+        }
+
+        unsigned int n = c.entrances.size();
+        for(unsigned int j = 0; j < n; ++j)
+        {
+            int d = c.distances[i*n+j];
+            if(d > 0) reach(c.entrances[j], cost + d, pos);
+        }
+
+        int x = pos % width;
+        int y = pos / width;
+        int around[4] = {
+            x > 0                       ? pos-1     : -1,
+            y < this->map->height-1     ? pos+width : -1,
+            x < width-1                 ? pos+1     : -1,
+            y > 0                       ? pos-width : -1 };
+        for(int next : around)
+        {
+            if(next < 0 || this->entranceIndex[next] < 0) continue;
+            if(this->getCluster(next) == cluster || !this->isPassable(next)) continue;
+            reach(next, cost + 1, pos);
+        }
+    }
+    if(bestEntrance < 0)
+    {
+        query.path.clear();
+        return;
+    }
+
+    std::vector<int> waypoints(1, to);
+    for(int pos = bestEntrance; pos != -1; pos = s.parent[pos]) waypoints.push_back(pos);
+    std::reverse(waypoints.begin(), waypoints.end());
+
+    /* Fill in the route between each pair of waypoints, which are either
+     * in the same cluster or next to each other across a side */
+    int current = from;
+    for(int waypoint : waypoints)
+    {
+        if(waypoint == current) continue;
+        int cluster = this->getCluster(current);
+        if(cluster != this->getCluster(waypoint))
+            query.path.push_back(waypoint);
+        else
+            this->search(current, waypoint, cluster, s, &query.path);
+        current = waypoint;
+    }
+    query.length = query.path.size() - 1;
+
+    return;
+}
+
+void Pathfinder::findPath(const Map& map, PathQuery& query)
+{
+    this->refresh(map);
+    this->findPath(query, this->scratch[0]);
+
+    return;
+}
+
+void Pathfinder::findPaths(const Map& map, std::vector<PathQuery>& queries, ThreadPool& pool)
+{
+    this->refresh(map);
+    if(this->scratch.size() < pool.getNumThreads()) this->scratch.resize(pool.getNumThreads());
+
+    pool.parallelFor(queries.size(), 16,
+        [this, &queries](unsigned int begin, unsigned int end, unsigned int thread)
+    {
+        for(unsigned int i = begin; i < end; ++i) this->findPath(queries[i], this->scratch[thread]);
+    });
+
+    return;
+}
+
+int Pathfinder::findShortestPath(const Map& map, int from, int to, std::vector<int>* path)
+{
+    this->refresh(map);
+    if(from < 0 || from >= map.tiles.size() || to < 0 || to >= map.tiles.size()) return -1;
+    if(!this->isPassable(from) || !this->isPassable(to)) return -1;
+
+    if(path != nullptr) path->assign(1, from);
+
+    return this->search(from, to, -1, this->scratch[0], path);
+}
+
+std::size_t Pathfinder::getSize() const
+{
+    std::size_t size = vectorSize(this->clusters) + vectorSize(this->entranceIndex) + vectorSize(this->scratch);
+    for(auto& cluster : this->clusters)
+        size += vectorSize(cluster.entrances) + vectorSize(cluster.distances);
+    for(auto& s : this->scratch)
+        size += vectorSize(s.marks) + vectorSize(s.cost) + vectorSize(s.parent);
+
+    return size;
+}
@@ -0,0 +1,140 @@
+#ifndef PATHFINDER_HPP
+#define PATHFINDER_HPP
+
+#include <vector>
+#include <cstddef>
+
+#include "tile.hpp"
+
+class Map;
+class ThreadPool;
+
+/* A route request and its answer */
+class PathQuery
+{
+    public:
+
+    int from;
+    int to;
+
+    /* Tiles visited from from to to inclusive, empty if there is no
+     * route */
+    std::vector<int> path;
+
+    /* Number of steps taken, or -1 if there is no route */
+    int length;
+
+    PathQuery(int from, int to)
+    {
+        this->from = from;
+        this->to = to;
+        this->length = -1;
+    }
+};
+
+/* Finds routes across the tiles of the passable types. Long routes are
+ * first planned across square clusters of tiles, joined at entrances
+ * along their borders, and then filled in within each cluster, which
+ * visits far fewer tiles than searching the whole map. Routes found
+ * this way are close to, but not always, the shortest */
+class Pathfinder
+{
+    private:
+
+    /* Cluster entrances and the distances between them, without
+     * leaving the cluster */
+    class Cluster
+    {
+        public:
+
+        std::vector<int> entrances;
+        /* entrances.size() squared, -1 where unreachable */
+        std::vector<int> distances;
+
+        bool dirty;
+
+        Cluster() { this->dirty = true; }
+    };
+
+    /* Per-search storage, one per thread. A tile's entries are only
+     * valid if its mark equals the current search's */
+    class Scratch
+    {
+        public:
+
+        std::vector<unsigned int> marks;
+        std::vector<int> cost;
+        std::vector<int> parent;
+        unsigned int currentMark;
+
+        /* Start a new search, returning its mark */
+        unsigned int begin(unsigned int size);
+
+        Scratch() { this->currentMark = 0; }
+    };
+
+    const Map* map;
+
+    std::vector<Cluster> clusters;
+    unsigned int clustersX;
+    unsigned int clustersY;
+
+    /* Index of each tile in its cluster's entrances, or -1 */
+    std::vector<int> entranceIndex;
+
+    std::vector<Scratch> scratch;
+
+    int getCluster(int pos) const;
+    bool isPassable(int pos) const;
+
+    /* A* between two tiles. If cluster is not -1 the search may not
+     * leave it. Appends the route, excluding from, to path */
+    int search(int from, int to, int cluster, Scratch& s, std::vector<int>* path) const;
+
+    /* Distances from pos to every tile of its cluster, staying inside
+     * it. Results are left in s.cost, valid where s.marks matches */
+    void flood(int pos, Scratch& s) const;
+
+    void rebuildCluster(int cluster);
+
+    void findPath(PathQuery& query, Scratch& s) const;
+
+    public:
+
+    /* Tiles that routes may pass through */
+    TileTypeSet passable;
+
+    /* Width and height of a cluster, in tiles */
+    const static int clusterSize = 8;
+
+    /* Mark the clusters the tiles at the given positions affect as out
+     * of date. Clusters are rebuilt before the next query */
+    void invalidate(const Map& map, const std::vector<int>& changed);
+    void invalidateAll();
+
+    /* Rebuild any out of date clusters of the map */
+    void refresh(const Map& map);
+
+    /* Find a single route */
+    void findPath(const Map& map, PathQuery& query);
+
+    /* Find every route, spread across the pool's threads */
+    void findPaths(const Map& map, std::vector<PathQuery>& queries, ThreadPool& pool);
+
+    /* Shortest route over the whole grid, for checking against the
+     * clustered routes */
+    int findShortestPath(const Map& map, int from, int to, std::vector<int>* path = nullptr);
+
+    /* Memory used, in bytes */
+    std::size_t getSize() const;
+
+    Pathfinder(TileTypeSet passable)
+    {
+        this->map = nullptr;
+        this->clustersX = 0;
+        this->clustersY = 0;
+        this->passable = passable;
+    }
+};
+
+#endif /* PATHFINDER_HPP */
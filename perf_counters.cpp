@@ -0,0 +1,204 @@
+#include <string>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <iomanip>
+#include <iostream>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perf_counters.hpp"
+
+PerfCounters counters;
+
+#ifdef __linux__
+/* A group of counters for one thread, read together in one call */
+class ThreadCounters
+{
+    public:
+
+    int fds[numCounterTypes];
+    bool opened;
+    bool available;
+
+    void open()
+    {
+        static const std::uint64_t configs[numCounterTypes] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+
+        this->opened = true;
+        for(int i = 0; i < numCounterTypes; ++i)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            /* The leader starts the whole group at once */
+            attr.disabled = i == 0;
+
+            int leader = i == 0 ? -1 : this->fds[0];
+            this->fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+            if(this->fds[i] < 0)
+            {
+                this->close(i);
+                return;
+            }
+        }
+        ioctl(this->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(this->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        this->available = true;
+
+        return;
+    }
+
+    /* Close the first n counters */
+    void close(int n)
+    {
+        for(int i = 0; i < n; ++i) ::close(this->fds[i]);
+        this->available = false;
+
+        return;
+    }
+
+    ThreadCounters()
+    {
+        this->opened = false;
+        this->available = false;
+    }
+
+    ~ThreadCounters()
+    {
+        if(this->available) this->close(numCounterTypes);
+    }
+};
+
+static thread_local ThreadCounters threadCounters;
+#endif
+
+bool PerfCounters::read(std::uint64_t* values)
+{
+#ifdef __linux__
+    ThreadCounters& thread = threadCounters;
+    if(!thread.opened) thread.open();
+    if(!thread.available) return false;
+
+    /* The group is read as its size followed by each value */
+    std::uint64_t buffer[1 + numCounterTypes];
+    if(::read(thread.fds[0], buffer, sizeof(buffer)) != sizeof(buffer)) return false;
+    for(int i = 0; i < numCounterTypes; ++i) values[i] = buffer[1+i];
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PerfCounters::start()
+{
+    std::uint64_t values[numCounterTypes];
+    if(!PerfCounters::read(values))
+    {
+        std::cerr << "Error, hardware performance counters are not available" << std::endl;
+        return false;
+    }
+    this->enabled = true;
+
+    return true;
+}
+
+void PerfCounters::clear()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->totals.clear();
+
+    return;
+}
+
+void PerfCounters::add(const char* name, const std::uint64_t* before, const std::uint64_t* after)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    CounterTotals& totals = this->totals[name];
+    for(int i = 0; i < numCounterTypes; ++i) totals.values[i] += after[i] - before[i];
+    ++totals.calls;
+
+    return;
+}
+
+std::map<std::string, CounterTotals> PerfCounters::getTotals()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    return this->totals;
+}
+
+const char* PerfCounters::getName(CounterType type)
+{
+    switch(type)
+    {
+        case CounterType::CYCLES:           return "cycles";
+        case CounterType::INSTRUCTIONS:     return "instructions";
+        case CounterType::CACHE_MISSES:     return "cacheMisses";
+        case CounterType::BRANCH_MISSES:    return "branchMisses";
+    }
+
+    return "";
+}
+
+void PerfCounters::print(std::ostream& out, double units, const std::string& unitName)
+{
+    out << "Hardware counters per " << unitName << ":" << std::endl;
+    out << std::left << std::setw(28) << "zone" << std::right;
+    for(int i = 0; i < numCounterTypes; ++i) out << std::setw(16) << PerfCounters::getName(CounterType(i));
+    out << std::setw(8) << "IPC" << std::endl;
+
+    for(auto& zone : this->getTotals())
+    {
+        const CounterTotals& totals = zone.second;
+        out << std::left << std::setw(28) << zone.first << std::right;
+        for(int i = 0; i < numCounterTypes; ++i)
+            out << std::setw(16) << std::uint64_t(totals.values[i] / units);
+
+        double cycles = totals.values[int(CounterType::CYCLES)];
+        double instructions = totals.values[int(CounterType::INSTRUCTIONS)];
+        out << std::setw(8) << std::fixed << std::setprecision(2)
+            << (cycles > 0 ? instructions / cycles : 0.0) << std::endl;
+        out.unsetf(std::ios::fixed);
+    }
+
+    return;
+}
+
+void PerfCounters::printJSON(std::ostream& out, double units)
+{
+    out << "{";
+    bool first = true;
+    for(auto& zone : this->getTotals())
+    {
+        out << (first ? "" : ",") << std::endl << "    \"" << zone.first << "\": { ";
+        for(int i = 0; i < numCounterTypes; ++i)
+        {
+            out << "\"" << PerfCounters::getName(CounterType(i)) << "\": "
+                << std::uint64_t(zone.second.values[i] / units) << ", ";
+        }
+        out << "\"calls\": " << zone.second.calls / units << " }";
+        first = false;
+    }
+    out << std::endl << "  }";
+
+    return;
+}
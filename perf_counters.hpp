@@ -0,0 +1,79 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <ostream>
+#include <cstdint>
+
+enum class CounterType { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES };
+const int numCounterTypes = 4;
+
+/* Hardware events counted while a zone of code ran, summed over every
+ * time it ran */
+class CounterTotals
+{
+    public:
+
+    std::uint64_t values[numCounterTypes];
+    std::uint64_t calls;
+
+    CounterTotals()
+    {
+        for(auto& value : this->values) value = 0;
+        this->calls = 0;
+    }
+};
+
+/* Counts hardware events with perf_event_open while each TraceZone runs,
+ * so that a pass can be judged on the cycles, instructions and cache and
+ * branch misses it took rather than just its time. Each thread opens its
+ * own counters the first time they are read. Only available on Linux,
+ * and only if the kernel allows it (see perf_event_paranoid) */
+class PerfCounters
+{
+    private:
+
+    std::map<std::string, CounterTotals> totals;
+    std::mutex mutex;
+
+    public:
+
+    /* Checked before reading the counters, so disabled counters cost
+     * next to nothing */
+    std::atomic<bool> enabled;
+
+    /* Start counting, returning false if the counters are unavailable */
+    bool start();
+    void stop() { this->enabled = false; }
+    void clear();
+
+    /* Read the counters of the calling thread. Returns false if they are
+     * unavailable */
+    static bool read(std::uint64_t* values);
+
+    /* Add the events counted between two reads to a zone */
+    void add(const char* name, const std::uint64_t* before, const std::uint64_t* after);
+
+    std::map<std::string, CounterTotals> getTotals();
+
+    static const char* getName(CounterType type);
+
+    /* Write a table of the events per unit, e.g. per simulated day */
+    void print(std::ostream& out, double units, const std::string& unitName);
+
+    /* Write the events per unit as a JSON object */
+    void printJSON(std::ostream& out, double units);
+
+    PerfCounters()
+    {
+        this->enabled = false;
+    }
+};
+
+/* Shared by every thread */
+extern PerfCounters counters;
+
+#endif /* PERF_COUNTERS_HPP */
@@ -0,0 +1,362 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+
+#include "regression.hpp"
+#include "city.hpp"
+#include "map.hpp"
+#include "statistics.hpp"
+
+/* 64 bit FNV-1a hash of the bytes of each value added */
+class Hasher
+{
+    public:
+
+    std::uint64_t value;
+
+    template<typename T>
+    void add(const T& x)
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&x);
+        for(unsigned int i = 0; i < sizeof(T); ++i)
+        {
+            this->value ^= bytes[i];
+            this->value *= 1099511628211ull;
+        }
+
+        return;
+    }
+
+    Hasher()
+    {
+        this->value = 14695981039346656037ull;
+    }
+};
+
+/* Labels of one layer of regions renumbered in the order their first
+ * tiles appear, so two labellings that group the tiles the same way
+ * are equal */
+static std::vector<unsigned int> canonicalRegions(const Map& map, int regionType)
+{
+    std::vector<unsigned int> labels(map.tiles.size(), 0);
+    std::vector<unsigned int> renumbered;
+    unsigned int next = 1;
+    for(unsigned int pos = 0; pos < map.tiles.size(); ++pos)
+    {
+        unsigned int label = map.tiles[pos].regions[regionType];
+        if(label == 0) continue;
+        if(label >= renumbered.size()) renumbered.resize(label+1, 0);
+        if(renumbered[label] == 0) renumbered[label] = next++;
+        labels[pos] = renumbered[label];
+    }
+
+    return labels;
+}
+
+/* Label one layer of regions by searching from each unlabelled tile in
+ * map order, as the map did before it labelled every layer in a single
+ * pass. Uses a stack rather than recursion so large regions fit */
+static std::vector<unsigned int> searchRegions(const Map& map, TileTypeSet whitelist,
+    unsigned int& numRegions)
+{
+    std::vector<unsigned int> labels(map.tiles.size(), 0);
+    std::vector<int> stack;
+    numRegions = 1;
+    for(unsigned int start = 0; start < map.tiles.size(); ++start)
+    {
+        if(labels[start] != 0 || !whitelist.contains(map.tiles[start].tileType)) continue;
+
+        labels[start] = numRegions;
+        stack.push_back(start);
+        while(!stack.empty())
+        {
+            int pos = stack.back();
+            stack.pop_back();
+            int x = pos % map.width;
+            int y = pos / map.width;
+            int neighbours[4] = { x > 0 ? pos-1 : -1, y < map.height-1 ? pos+int(map.width) : -1,
+                x < map.width-1 ? pos+1 : -1, y > 0 ? pos-int(map.width) : -1 };
+            for(int npos : neighbours)
+            {
+                if(npos < 0 || labels[npos] != 0 || !whitelist.contains(map.tiles[npos].tileType)) continue;
+                labels[npos] = numRegions;
+                stack.push_back(npos);
+            }
+        }
+        ++numRegions;
+    }
+
+    return labels;
+}
+
+GoldenSample::GoldenSample(const City& city)
+{
+    this->day = city.day;
+    this->state = GoldenRecord::hashState(city);
+    this->stats = GoldenRecord::hashStats(city.stats);
+    this->population = city.population;
+    this->homeless = city.getHomeless();
+    this->employable = city.employable;
+    this->unemployed = city.getUnemployed();
+    this->funds = city.funds;
+}
+
+std::uint64_t GoldenRecord::hashState(const City& city)
+{
+    Hasher hasher;
+    const Map& map = city.map;
+
+    hasher.add(map.width);
+    hasher.add(map.height);
+    for(auto& tile : map.tiles)
+    {
+        hasher.add(tile.tileType);
+        hasher.add(tile.tileVariant);
+        hasher.add(tile.population);
+        hasher.add(tile.production);
+        hasher.add(tile.storedGoods);
+    }
+    for(int type = 0; type < numRegionTypes; ++type)
+    {
+        for(auto label : canonicalRegions(map, type)) hasher.add(label);
+    }
+    for(auto resource : map.resources) hasher.add(resource);
+
+    hasher.add(city.day);
+    hasher.add(city.population);
+    hasher.add(city.employable);
+    hasher.add(city.getHomeless());
+    hasher.add(city.getUnemployed());
+    hasher.add(city.residentialTax);
+    hasher.add(city.commercialTax);
+    hasher.add(city.industrialTax);
+    hasher.add(city.earnings);
+    hasher.add(city.funds);
+
+    return hasher.value;
+}
+
+std::uint64_t GoldenRecord::hashStats(const StatsRecorder& stats)
+{
+    Hasher hasher;
+
+    for(auto& series : stats.series)
+    {
+        hasher.add(series.size());
+        for(unsigned int i = 0; i < series.size(); ++i)
+        {
+            const CityStats& sample = series[i];
+            hasher.add(sample.day);
+            hasher.add(sample.days);
+            hasher.add(sample.population);
+            hasher.add(sample.employable);
+            hasher.add(sample.homeless);
+            hasher.add(sample.unemployed);
+            hasher.add(sample.funds);
+            hasher.add(sample.earnings);
+            for(auto& region : sample.regions)
+            {
+                hasher.add(region.region);
+                hasher.add(region.zones);
+                hasher.add(region.residents);
+                hasher.add(region.workers);
+            }
+        }
+    }
+
+    return hasher.value;
+}
+
+bool GoldenRecord::save(const std::string& filename) const
+{
+    std::ofstream outputFile(filename, std::ios::out);
+    if(!outputFile.is_open())
+    {
+        std::cerr << "Error, could not open " << filename << std::endl;
+        return false;
+    }
+
+    outputFile << "# day state stats population homeless employable unemployed funds" << std::endl;
+    outputFile << std::setprecision(17);
+    for(auto& sample : this->samples)
+    {
+        outputFile << sample.day << " " << std::hex << std::setfill('0')
+            << std::setw(16) << sample.state << " " << std::setw(16) << sample.stats
+            << std::dec << std::setfill(' ') << " " << sample.population << " " << sample.homeless
+            << " " << sample.employable << " " << sample.unemployed << " " << sample.funds << std::endl;
+    }
+
+    return true;
+}
+
+bool GoldenRecord::load(const std::string& filename)
+{
+    std::ifstream inputFile(filename, std::ios::in);
+    if(!inputFile.is_open())
+    {
+        std::cerr << "Error, could not open " << filename << std::endl;
+        return false;
+    }
+
+    this->samples.clear();
+    std::string line;
+    for(int lineNumber = 1; std::getline(inputFile, line); ++lineNumber)
+    {
+        if(line.empty() || line[0] == '#') continue;
+
+        std::istringstream stream(line);
+        GoldenSample sample;
+        stream >> sample.day >> std::hex >> sample.state >> sample.stats >> std::dec
+            >> sample.population >> sample.homeless >> sample.employable >> sample.unemployed >> sample.funds;
+        if(stream.fail())
+        {
+            std::cerr << "Error, could not read line " << lineNumber << " of " << filename << std::endl;
+            return false;
+        }
+        this->samples.push_back(sample);
+    }
+
+    return true;
+}
+
+bool GoldenRecord::compare(const GoldenRecord& expected, std::ostream& out) const
+{
+    unsigned int n = std::min(this->samples.size(), expected.samples.size());
+    for(unsigned int i = 0; i < n; ++i)
+    {
+        const GoldenSample& sample = this->samples[i];
+        const GoldenSample& golden = expected.samples[i];
+
+        std::ostringstream differences;
+        differences << std::setprecision(17);
+        if(sample.day != golden.day)
+            differences << ", sampled on day " << sample.day;
+        if(sample.state != golden.state)
+            differences << ", state differs";
+        if(sample.stats != golden.stats)
+            differences << ", statistics differ";
+        if(sample.population != golden.population)
+            differences << ", population " << sample.population << " (expected " << golden.population << ")";
+        if(sample.homeless != golden.homeless)
+            differences << ", homeless " << sample.homeless << " (expected " << golden.homeless << ")";
+        if(sample.employable != golden.employable)
+            differences << ", employable " << sample.employable << " (expected " << golden.employable << ")";
+        if(sample.unemployed != golden.unemployed)
+            differences << ", unemployed " << sample.unemployed << " (expected " << golden.unemployed << ")";
+        if(sample.funds != golden.funds)
+            differences << ", funds " << sample.funds << " (expected " << golden.funds << ")";
+
+        /* Every later day differs too once one has */
+        if(!differences.str().empty())
+        {
+            out << "Day " << golden.day << " differs" << differences.str() << std::endl;
+            return false;
+        }
+    }
+
+    if(this->samples.size() != expected.samples.size())
+    {
+        out << "Took " << this->samples.size() << " samples, expected "
+            << expected.samples.size() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool checkMap(const Map& map, const TileTypeSet* whitelists, int rounds,
+    unsigned int seed, std::ostream& out)
+{
+    if(map.tiles.empty()) return true;
+
+    Map full = map;
+    full.findConnectedRegions(whitelists, 0, numRegionTypes);
+    for(int type = 0; type < numRegionTypes; ++type)
+    {
+        unsigned int numRegions;
+        std::vector<unsigned int> labels = searchRegions(full, whitelists[type], numRegions);
+        if(full.numRegions[type] != numRegions)
+        {
+            out << "Layer " << type << " has " << full.numRegions[type]-1 << " regions, expected "
+                << numRegions-1 << std::endl;
+            return false;
+        }
+        for(unsigned int pos = 0; pos < full.tiles.size(); ++pos)
+        {
+            if(full.tiles[pos].regions[type] == labels[pos]) continue;
+            out << "Tile (" << pos % full.width << ", " << pos / full.width << ") of layer " << type
+                << " is in region " << full.tiles[pos].regions[type] << ", expected " << labels[pos] << std::endl;
+            return false;
+        }
+    }
+
+    /* Make the same edits to both copies, updating one around each edit
+     * as the city does and the other all at once */
+    full.updateDirection(TileType::ROAD);
+    Map incremental = full;
+    std::mt19937 random(seed);
+    const TileType types[] = {
+        TileType::GRASS, TileType::FOREST, TileType::WATER, TileType::ROAD, TileType::ROAD,
+        TileType::RESIDENTIAL, TileType::COMMERCIAL, TileType::INDUSTRIAL };
+    const int numTypes = sizeof(types) / sizeof(types[0]);
+
+    for(int round = 0; round < rounds; ++round)
+    {
+        /* A rectangle of one type, like a placement in the editor */
+        int x0 = random() % full.width;
+        int y0 = random() % full.height;
+        int x1 = std::min(x0 + int(random() % 4), int(full.width)-1);
+        int y1 = std::min(y0 + int(random() % 4), int(full.height)-1);
+        TileType tileType = types[random() % numTypes];
+
+        std::vector<int> changed;
+        for(int y = y0; y <= y1; ++y)
+        {
+            for(int x = x0; x <= x1; ++x) changed.push_back(y*full.width+x);
+        }
+        std::vector<Tile> tiles(changed.size(), Tile(tileType));
+        full.setTiles(changed, tiles);
+        incremental.setTiles(changed, tiles);
+
+        incremental.updateDirection(TileType::ROAD, changed);
+        for(int type = 0; type < numRegionTypes; ++type)
+            incremental.updateConnectedRegions(whitelists[type], type, changed);
+        full.updateDirection(TileType::ROAD);
+        full.findConnectedRegions(whitelists, 0, numRegionTypes);
+
+        for(unsigned int pos = 0; pos < full.tiles.size(); ++pos)
+        {
+            if(incremental.tiles[pos].tileVariant == full.tiles[pos].tileVariant) continue;
+            out << "Round " << round << ": tile (" << pos % full.width << ", " << pos / full.width
+                << ") has variant " << incremental.tiles[pos].tileVariant << ", expected "
+                << full.tiles[pos].tileVariant << std::endl;
+            return false;
+        }
+        for(int zone = 0; zone < 3; ++zone)
+        {
+            std::vector<int> expected;
+            for(unsigned int pos = 0; pos < full.tiles.size(); ++pos)
+            {
+                if(Map::zoneIndex(full.tiles[pos].tileType) == zone) expected.push_back(pos);
+            }
+            if(incremental.zoneTiles[zone] == expected) continue;
+            out << "Round " << round << ": the index of zone " << zone << " is wrong" << std::endl;
+            return false;
+        }
+        for(int type = 0; type < numRegionTypes; ++type)
+        {
+            if(canonicalRegions(incremental, type) == canonicalRegions(full, type)) continue;
+            out << "Round " << round << ": layer " << type << " is split into different regions"
+                << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef REGRESSION_HPP
+#define REGRESSION_HPP
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+#include "tile.hpp"
+
+class City;
+class Map;
+class StatsRecorder;
+
+/* A city on one day, reduced to hashes of its state and statistics
+ * and the totals a person would check first */
+class GoldenSample
+{
+    public:
+
+    int day;
+
+    /* Hash of every tile and of the city's pools, taxes and funds */
+    std::uint64_t state;
+    /* Hash of every recorded statistic */
+    std::uint64_t stats;
+
+    double population;
+    double homeless;
+    double employable;
+    double unemployed;
+    double funds;
+
+    GoldenSample()
+    {
+        this->day = 0;
+        this->state = 0;
+        this->stats = 0;
+        this->population = 0;
+        this->homeless = 0;
+        this->employable = 0;
+        this->unemployed = 0;
+        this->funds = 0;
+    }
+
+    GoldenSample(const City& city);
+};
+
+/* Samples of a city taken while it runs, saved as a golden file once
+ * the simulation is known to be right and compared against after it
+ * has been optimised. Doubles are hashed bit for bit, so a change has
+ * to give exactly the same results to pass */
+class GoldenRecord
+{
+    public:
+
+    std::vector<GoldenSample> samples;
+
+    void add(const City& city) { this->samples.push_back(GoldenSample(city)); }
+
+    /* Return false if the file could not be opened or read */
+    bool save(const std::string& filename) const;
+    bool load(const std::string& filename);
+
+    /* Compare against the expected record, writing the first day that
+     * differs to out. Return true if every sample matches */
+    bool compare(const GoldenRecord& expected, std::ostream& out) const;
+
+    /* Regions are hashed by which tiles they group, not their labels,
+     * since updating them in place renumbers them */
+    static std::uint64_t hashState(const City& city);
+    static std::uint64_t hashStats(const StatsRecorder& stats);
+};
+
+/* Check the map's optimised functions against the plain versions of
+ * them on copies of the map. Regions labelled in a single pass must
+ * match a search from each unlabelled tile, and after each of rounds
+ * random edits the directions and regions updated around the edit
+ * must match those of the whole map, and the zone index must match a
+ * scan of it. Mismatches are written to out.
+ * Return true if there were none */
+bool checkMap(const Map& map, const TileTypeSet* whitelists, int rounds,
+    unsigned int seed, std::ostream& out);
+
+#endif /* REGRESSION_HPP */
@@ -0,0 +1,195 @@
+#include <SFML/System.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+
+#include "replay.hpp"
+#include "city.hpp"
+#include "tile.hpp"
+
+unsigned int Command::execute(City& city, TileAtlas& tileAtlas) const
+{
+    switch(this->type)
+    {
+        case CommandType::PLACE_TILES:
+        {
+            /* Select the tiles again instead of trusting the selection
+             * made while dragging, which may be a day out of date */
+            return city.placeTiles(tileAtlas[this->tileType], this->start, this->end);
+        }
+        case CommandType::SET_TAX:
+        {
+            if(this->tileType == TileType::RESIDENTIAL)     city.residentialTax = this->tax;
+            else if(this->tileType == TileType::COMMERCIAL) city.commercialTax  = this->tax;
+            else if(this->tileType == TileType::INDUSTRIAL) city.industrialTax  = this->tax;
+            /* Taxes change how quickly zones hire */
+            city.activity.wakeAll();
+            break;
+        }
+        case CommandType::UNDO:
+        {
+            city.undo();
+            break;
+        }
+        case CommandType::REDO:
+        {
+            city.redo();
+            break;
+        }
+        case CommandType::PAUSE:
+        {
+            city.paused = this->paused;
+            break;
+        }
+        case CommandType::SET_SPEED:
+        {
+            city.speed = this->speed;
+            break;
+        }
+        default: break;
+    }
+
+    return 0;
+}
+
+void Recorder::open(const std::string& filename, const std::string& cityName, unsigned int seed)
+{
+    this->outputFile.open(filename, std::ios::out);
+
+    /* Taxes must survive the round trip exactly */
+    this->outputFile << std::setprecision(17);
+
+    this->outputFile << "seed " << seed << std::endl;
+    this->outputFile << "city " << cityName << std::endl;
+
+    return;
+}
+
+void Recorder::close(int day)
+{
+    if(!this->outputFile.is_open()) return;
+
+    this->outputFile << day << " end" << std::endl;
+    this->outputFile.close();
+
+    return;
+}
+
+void Recorder::record(const Command& command)
+{
+    if(!this->outputFile.is_open()) return;
+
+    /* Flush every command so a crashed session can still be replayed */
+    switch(command.type)
+    {
+        case CommandType::PLACE_TILES:
+            this->outputFile << command.day << " place "
+                << command.start.x << " " << command.start.y << " "
+                << command.end.x << " " << command.end.y << " "
+                << int(command.tileType) << std::endl;
+            break;
+        case CommandType::SET_TAX:
+            this->outputFile << command.day << " tax "
+                << int(command.tileType) << " " << command.tax << std::endl;
+            break;
+        case CommandType::UNDO:
+            this->outputFile << command.day << " undo" << std::endl;
+            break;
+        case CommandType::REDO:
+            this->outputFile << command.day << " redo" << std::endl;
+            break;
+        default: break;
+    }
+
+    return;
+}
+
+bool Replay::load(const std::string& filename)
+{
+    std::ifstream inputFile(filename, std::ios::in);
+    if(!inputFile.is_open())
+    {
+        std::cerr << "Error, could not open replay " << filename << std::endl;
+        return false;
+    }
+
+    this->commands.clear();
+    this->next = 0;
+    this->endDay = 0;
+
+    std::string line;
+
+    while(std::getline(inputFile, line))
+    {
+        std::istringstream lineStream(line);
+        std::string key;
+        if(!(lineStream >> key)) continue;
+
+        if(key == "seed")       lineStream >> this->seed;
+        else if(key == "city")  lineStream >> this->cityName;
+        else
+        {
+            Command command;
+            std::string type;
+            int tileType = 0;
+            command.day = std::stoi(key);
+            lineStream >> type;
+            if(type == "place")
+            {
+                command.type = CommandType::PLACE_TILES;
+                lineStream >> command.start.x >> command.start.y
+                    >> command.end.x >> command.end.y >> tileType;
+            }
+            else if(type == "tax")
+            {
+                command.type = CommandType::SET_TAX;
+                lineStream >> tileType >> command.tax;
+            }
+            else if(type == "undo")
+            {
+                command.type = CommandType::UNDO;
+            }
+            else if(type == "redo")
+            {
+                command.type = CommandType::REDO;
+            }
+            else if(type == "end")
+            {
+                this->endDay = command.day;
+                continue;
+            }
+            else
+            {
+                std::cerr << "Error, unknown command " << type << std::endl;
+                continue;
+            }
+            command.tileType = TileType(tileType);
+            this->commands.push_back(command);
+            if(command.day > this->endDay) this->endDay = command.day;
+        }
+    }
+
+    inputFile.close();
+
+    return true;
+}
+
+void Replay::apply(City& city, TileAtlas& tileAtlas)
+{
+    while(this->next < this->commands.size() &&
+        this->commands[this->next].day <= city.day)
+    {
+        this->commands[this->next++].execute(city, tileAtlas);
+    }
+
+    return;
+}
+
+bool Replay::finished(const City& city) const
+{
+    return this->next >= this->commands.size() && city.day >= this->endDay;
+}
@@ -0,0 +1,135 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <SFML/System.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+
+#include "city.hpp"
+#include "tile.hpp"
+
+enum class CommandType { PLACE_TILES, SET_TAX, UNDO, REDO, PAUSE, SET_SPEED, END };
+
+/* A single state-changing action made by the player, tagged with the
+ * day it was made on so that it can be reapplied at the same point in
+ * the simulation */
+class Command
+{
+    public:
+
+    CommandType type;
+
+    int day;
+
+    /* Selection rectangle and placed tile for PLACE_TILES */
+    sf::Vector2i start;
+    sf::Vector2i end;
+
+    /* Placed tile for PLACE_TILES, taxed zone for SET_TAX */
+    TileType tileType;
+
+    /* New tax rate for SET_TAX */
+    double tax;
+
+    /* Whether PAUSE pauses or resumes the simulation */
+    bool paused;
+
+    /* New speed for SET_SPEED, in days per second */
+    float speed;
+
+    /* Apply the command to the city. Returns the amount charged */
+    unsigned int execute(City& city, TileAtlas& tileAtlas) const;
+
+    /* Constructor */
+    Command()
+    {
+        this->type = CommandType::END;
+        this->day = 0;
+        this->tileType = TileType::VOID;
+        this->tax = 0.0;
+        this->paused = true;
+        this->speed = 1.0f;
+    }
+    Command(int day, sf::Vector2i start, sf::Vector2i end, TileType tileType) : Command()
+    {
+        this->type = CommandType::PLACE_TILES;
+        this->day = day;
+        this->start = start;
+        this->end = end;
+        this->tileType = tileType;
+    }
+    Command(int day, CommandType type) : Command()
+    {
+        this->type = type;
+        this->day = day;
+    }
+    Command(int day, TileType tileType, double tax) : Command()
+    {
+        this->type = CommandType::SET_TAX;
+        this->day = day;
+        this->tileType = tileType;
+        this->tax = tax;
+    }
+};
+
+/* Writes every command of a play session to disk as it happens, so
+ * that the session can be replayed exactly. Pausing and the speed only
+ * change when days pass, not what happens on them, so are not written */
+class Recorder
+{
+    private:
+
+    std::ofstream outputFile;
+
+    public:
+
+    /* Start a new recording, overwriting any existing file. The
+     * seed must be the one the city's random numbers were seeded with */
+    void open(const std::string& filename, const std::string& cityName, unsigned int seed);
+
+    /* Mark the end of the session and close the file */
+    void close(int day);
+
+    void record(const Command& command);
+};
+
+/* Feeds a recorded session back into a city */
+class Replay
+{
+    private:
+
+    std::vector<Command> commands;
+
+    /* Index of the next command to be applied */
+    unsigned int next;
+
+    /* Day the session ended on */
+    int endDay;
+
+    public:
+
+    unsigned int seed;
+    std::string cityName;
+
+    /* Load a recording from disk, returning false on failure */
+    bool load(const std::string& filename);
+
+    /* Apply every command made on or before the city's current day */
+    void apply(City& city, TileAtlas& tileAtlas);
+
+    /* True once every command has been applied and the city has
+     * reached the day the session ended on */
+    bool finished(const City& city) const;
+
+    /* Constructor */
+    Replay()
+    {
+        this->next = 0;
+        this->endDay = 0;
+        this->seed = 0;
+    }
+};
+
+#endif /* REPLAY_HPP */
@@ -0,0 +1,326 @@
+#include <vector>
+#include <queue>
+#include <limits>
+#include <algorithm>
+#include <functional>
+
+#include "road_network.hpp"
+#include "map.hpp"
+#include "tile.hpp"
+#include "memory.hpp"
+
+int RoadNetwork::getNeighbours(const Map& map, int pos, int neighbours[4]) const
+{
+    int x = pos % map.width;
+    int y = pos / map.width;
+    int n = 0;
+
+    if(x > 0 && map.tiles[pos-1].tileType == TileType::ROAD)
+        neighbours[n++] = pos-1;
+    if(y < map.height-1 && map.tiles[pos+map.width].tileType == TileType::ROAD)
+        neighbours[n++] = pos+map.width;
+    if(x < map.width-1 && map.tiles[pos+1].tileType == TileType::ROAD)
+        neighbours[n++] = pos+1;
+    if(y > 0 && map.tiles[pos-map.width].tileType == TileType::ROAD)
+        neighbours[n++] = pos-map.width;
+
+    return n;
+}
+
+int RoadNetwork::addNode(int pos)
+{
+    int node;
+    if(!this->freeNodes.empty())
+    {
+        node = this->freeNodes.back();
+        this->freeNodes.pop_back();
+        this->nodes[node] = RoadNode(pos);
+    }
+    else
+    {
+        node = this->nodes.size();
+        this->nodes.push_back(RoadNode(pos));
+    }
+    this->tileNode[pos] = node;
+    ++this->numNodes;
+
+    return node;
+}
+
+int RoadNetwork::addEdge(int from, int to, std::vector<int>& tiles)
+{
+    int edge;
+    if(!this->freeEdges.empty())
+    {
+        edge = this->freeEdges.back();
+        this->freeEdges.pop_back();
+        this->edges[edge] = RoadEdge(from, to);
+    }
+    else
+    {
+        edge = this->edges.size();
+        this->edges.push_back(RoadEdge(from, to));
+    }
+    for(int pos : tiles) this->tileEdge[pos] = edge;
+    this->edges[edge].tiles.swap(tiles);
+    this->nodes[from].edges.push_back(edge);
+    if(to != from) this->nodes[to].edges.push_back(edge);
+    ++this->numEdges;
+
+    return edge;
+}
+
+void RoadNetwork::removeEdge(int edge, std::vector<int>& retrace, std::vector<int>& nodes)
+{
+    RoadEdge& e = this->edges[edge];
+    for(int pos : e.tiles)
+    {
+        this->tileEdge[pos] = -1;
+        retrace.push_back(pos);
+    }
+    for(int node : e.nodes)
+    {
+        std::vector<int>& nodeEdges = this->nodes[node].edges;
+        nodeEdges.erase(std::remove(nodeEdges.begin(), nodeEdges.end(), edge), nodeEdges.end());
+        nodes.push_back(node);
+    }
+    e.tiles.clear();
+    e.alive = false;
+    this->freeEdges.push_back(edge);
+    --this->numEdges;
+
+    return;
+}
+
+void RoadNetwork::removeNode(int node, std::vector<int>& retrace, std::vector<int>& nodes)
+{
+    while(!this->nodes[node].edges.empty())
+    {
+        this->removeEdge(this->nodes[node].edges.back(), retrace, nodes);
+    }
+    RoadNode& n = this->nodes[node];
+    this->tileNode[n.pos] = -1;
+    retrace.push_back(n.pos);
+    n.alive = false;
+    this->freeNodes.push_back(node);
+    --this->numNodes;
+
+    return;
+}
+
+void RoadNetwork::traceEdges(const Map& map, int node)
+{
+    int start = this->nodes[node].pos;
+    int neighbours[4];
+    int numNeighbours = this->getNeighbours(map, start, neighbours);
+
+    for(int i = 0; i < numNeighbours; ++i)
+    {
+        int next = neighbours[i];
+
+        /* Adjacent nodes are joined directly, once */
+        if(this->tileNode[next] != -1)
+        {
+            int other = this->tileNode[next];
+            bool joined = false;
+            for(int edge : this->nodes[node].edges)
+            {
+                const RoadEdge& e = this->edges[edge];
+                if(e.tiles.empty() && e.getOther(node) == other) joined = true;
+            }
+            if(!joined)
+            {
+                std::vector<int> tiles;
+                this->addEdge(node, other, tiles);
+            }
+            continue;
+        }
+
+        /* Already traced from the node at the other end */
+        if(this->tileEdge[next] != -1) continue;
+
+        /* Every tile between nodes has exactly two road neighbours, so
+         * keep going forwards until a node is reached */
+        std::vector<int> tiles;
+        int prev = start;
+        int pos = next;
+        while(this->tileNode[pos] == -1)
+        {
+            tiles.push_back(pos);
+            int around[4];
+            int numAround = this->getNeighbours(map, pos, around);
+            int forward = around[0] == prev && numAround > 1 ? around[1] : around[0];
+            prev = pos;
+            pos = forward;
+        }
+        this->addEdge(node, this->tileNode[pos], tiles);
+    }
+
+    return;
+}
+
+void RoadNetwork::build(const Map& map)
+{
+    this->tileNode.assign(map.tiles.size(), -1);
+    this->tileEdge.assign(map.tiles.size(), -1);
+    this->nodes.clear();
+    this->edges.clear();
+    this->freeNodes.clear();
+    this->freeEdges.clear();
+    this->numNodes = 0;
+    this->numEdges = 0;
+
+    std::vector<int> changed;
+    for(int pos = 0; pos < map.tiles.size(); ++pos)
+    {
+        if(map.tiles[pos].tileType == TileType::ROAD) changed.push_back(pos);
+    }
+    this->update(map, changed);
+
+    return;
+}
+
+void RoadNetwork::update(const Map& map, const std::vector<int>& changed)
+{
+    if(this->tileNode.size() != map.tiles.size())
+    {
+        this->build(map);
+        return;
+    }
+
+    /* A change can only alter the number of road neighbours of the
+     * changed tiles and the tiles next to them, so tear down the nodes
+     * and edges covering those and retrace them */
+    std::vector<int> retrace;
+    std::vector<int> nodes;
+    for(int pos : changed)
+    {
+        int around[5] = { pos, -1, -1, -1, -1 };
+        int x = pos % map.width;
+        int y = pos / map.width;
+        if(x > 0)               around[1] = pos-1;
+        if(y < map.height-1)    around[2] = pos+map.width;
+        if(x < map.width-1)     around[3] = pos+1;
+        if(y > 0)               around[4] = pos-map.width;
+
+        for(int tile : around)
+        {
+            if(tile < 0) continue;
+            if(this->tileNode[tile] != -1)
+                this->removeNode(this->tileNode[tile], retrace, nodes);
+            else if(this->tileEdge[tile] != -1)
+                this->removeEdge(this->tileEdge[tile], retrace, nodes);
+            retrace.push_back(tile);
+        }
+    }
+
+    /* Junctions and dead ends become nodes */
+    for(int pos : retrace)
+    {
+        if(map.tiles[pos].tileType != TileType::ROAD) continue;
+        if(this->tileNode[pos] != -1 || this->tileEdge[pos] != -1) continue;
+
+        int neighbours[4];
+        if(this->getNeighbours(map, pos, neighbours) != 2)
+            nodes.push_back(this->addNode(pos));
+    }
+    for(int node : nodes)
+    {
+        if(this->nodes[node].alive) this->traceEdges(map, node);
+    }
+
+    /* Anything left is a loop without junctions, which needs a node
+     * somewhere to hang its edge from */
+    for(int pos : retrace)
+    {
+        if(map.tiles[pos].tileType != TileType::ROAD) continue;
+        if(this->tileNode[pos] != -1 || this->tileEdge[pos] != -1) continue;
+
+        this->traceEdges(map, this->addNode(pos));
+    }
+
+    return;
+}
+
+int RoadNetwork::distance(int from, int to) const
+{
+    if(from < 0 || from >= this->tileNode.size()) return -1;
+    if(to < 0 || to >= this->tileNode.size()) return -1;
+
+    const unsigned int unreachable = std::numeric_limits<unsigned int>::max();
+    std::vector<unsigned int> dist(this->nodes.size(), unreachable);
+
+    typedef std::pair<unsigned int, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    /* Start from the source node, or both ends of its edge */
+    auto reach = [&](int node, unsigned int d)
+    {
+        if(d < dist[node])
+        {
+            dist[node] = d;
+            queue.push(Entry(d, node));
+        }
+    };
+    unsigned int direct = unreachable;
+    if(this->tileNode[from] != -1)
+    {
+        reach(this->tileNode[from], 0);
+    }
+    else if(this->tileEdge[from] != -1)
+    {
+        const RoadEdge& e = this->edges[this->tileEdge[from]];
+        unsigned int i = std::find(e.tiles.begin(), e.tiles.end(), from) - e.tiles.begin();
+        reach(e.nodes[0], i+1);
+        reach(e.nodes[1], e.getLength()-(i+1));
+
+        /* Both tiles may be on the same stretch of road */
+        if(this->tileEdge[to] == this->tileEdge[from])
+        {
+            unsigned int j = std::find(e.tiles.begin(), e.tiles.end(), to) - e.tiles.begin();
+            direct = i > j ? i-j : j-i;
+        }
+    }
+    else return -1;
+
+    while(!queue.empty())
+    {
+        Entry entry = queue.top();
+        queue.pop();
+        if(entry.first > dist[entry.second]) continue;
+
+        for(int edge : this->nodes[entry.second].edges)
+        {
+            const RoadEdge& e = this->edges[edge];
+            reach(e.getOther(entry.second), entry.first + e.getLength());
+        }
+    }
+
+    /* Finish at the destination node, or whichever end of its edge
+     * is closer */
+    unsigned int best = direct;
+    if(this->tileNode[to] != -1)
+    {
+        best = std::min(best, dist[this->tileNode[to]]);
+    }
+    else if(this->tileEdge[to] != -1)
+    {
+        const RoadEdge& e = this->edges[this->tileEdge[to]];
+        unsigned int j = std::find(e.tiles.begin(), e.tiles.end(), to) - e.tiles.begin();
+        if(dist[e.nodes[0]] != unreachable) best = std::min(best, dist[e.nodes[0]] + j+1);
+        if(dist[e.nodes[1]] != unreachable) best = std::min(best, dist[e.nodes[1]] + e.getLength()-(j+1));
+    }
+
+    return best == unreachable ? -1 : int(best);
+}
+
+std::size_t RoadNetwork::getSize() const
+{
+    std::size_t size = vectorSize(this->tileNode) + vectorSize(this->tileEdge) +
+        vectorSize(this->freeNodes) + vectorSize(this->freeEdges) +
+        vectorSize(this->nodes) + vectorSize(this->edges);
+    for(auto& node : this->nodes) size += vectorSize(node.edges);
+    for(auto& edge : this->edges) size += vectorSize(edge.tiles);
+
+    return size;
+}
@@ -0,0 +1,122 @@
+#ifndef ROAD_NETWORK_HPP
+#define ROAD_NETWORK_HPP
+
+#include <vector>
+#include <cstddef>
+
+class Map;
+
+/* An intersection or end of a road */
+class RoadNode
+{
+    public:
+
+    int pos;
+
+    /* Indices of the edges leaving the node */
+    std::vector<int> edges;
+
+    bool alive;
+
+    RoadNode(int pos)
+    {
+        this->pos = pos;
+        this->alive = true;
+    }
+};
+
+/* A stretch of road between two nodes with no junctions along it */
+class RoadEdge
+{
+    public:
+
+    int nodes[2];
+
+    /* Road tiles between the nodes, in order from nodes[0] */
+    std::vector<int> tiles;
+
+    bool alive;
+
+    /* Number of tiles travelled from one node to the other */
+    unsigned int getLength() const { return this->tiles.size() + 1; }
+
+    /* The node at the other end of the edge */
+    int getOther(int node) const
+    {
+        return this->nodes[0] == node ? this->nodes[1] : this->nodes[0];
+    }
+
+    RoadEdge(int from, int to)
+    {
+        this->nodes[0] = from;
+        this->nodes[1] = to;
+        this->alive = true;
+    }
+};
+
+/* Graph of the map's roads, which is far smaller than the map and so
+ * much faster to route across. Nodes are placed on every road tile that
+ * does not have exactly two road neighbours, and on one tile of any
+ * loop without junctions */
+class RoadNetwork
+{
+    private:
+
+    /* Node of each tile, or -1 */
+    std::vector<int> tileNode;
+    /* Edge each tile is part of, or -1 */
+    std::vector<int> tileEdge;
+
+    /* Indices of dead nodes and edges that can be reused */
+    std::vector<int> freeNodes;
+    std::vector<int> freeEdges;
+
+    /* Road tiles sharing a side with pos, returning how many */
+    int getNeighbours(const Map& map, int pos, int neighbours[4]) const;
+
+    int addNode(int pos);
+    int addEdge(int from, int to, std::vector<int>& tiles);
+
+    /* Remove a node or edge, adding the tiles it covered to retrace and
+     * the surviving nodes that lost an edge to nodes */
+    void removeNode(int node, std::vector<int>& retrace, std::vector<int>& nodes);
+    void removeEdge(int edge, std::vector<int>& retrace, std::vector<int>& nodes);
+
+    /* Follow every untraced road leaving the node to the next node */
+    void traceEdges(const Map& map, int node);
+
+    public:
+
+    std::vector<RoadNode> nodes;
+    std::vector<RoadEdge> edges;
+
+    unsigned int numNodes;
+    unsigned int numEdges;
+
+    /* Build the network from scratch */
+    void build(const Map& map);
+
+    /* Rebuild only the parts of the network around the tiles at the
+     * given positions */
+    void update(const Map& map, const std::vector<int>& changed);
+
+    /* Node at pos, or -1 */
+    int getNode(int pos) const { return this->tileNode[pos]; }
+    /* Edge running through pos, or -1 */
+    int getEdge(int pos) const { return this->tileEdge[pos]; }
+
+    /* Length of the shortest route between two road tiles, or -1 if
+     * either is not a road or they are not connected */
+    int distance(int from, int to) const;
+
+    /* Memory used, in bytes */
+    std::size_t getSize() const;
+
+    RoadNetwork()
+    {
+        this->numNodes = 0;
+        this->numEdges = 0;
+    }
+};
+
+#endif /* ROAD_NETWORK_HPP */
@@ -0,0 +1,126 @@
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "selection.hpp"
+#include "memory.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+unsigned int Selection::countBits(std::uint64_t word)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(word);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return (unsigned int)__popcnt64(word);
+#else
+    unsigned int n = 0;
+    for(; word != 0; word &= word - 1) ++n;
+    return n;
+#endif
+}
+
+unsigned int Selection::lowestBit(std::uint64_t word)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(word);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return index;
+#else
+    unsigned int n = 0;
+    for(; (word & 1) == 0; word >>= 1) ++n;
+    return n;
+#endif
+}
+
+void Selection::resize(unsigned int width, unsigned int height)
+{
+    this->width = width;
+    this->height = height;
+    this->wordsPerRow = (width + 63) / 64;
+
+    this->valid.assign(this->wordsPerRow * height, 0);
+    this->invalid.assign(this->wordsPerRow * height, 0);
+
+    this->left = this->top = 0;
+    this->right = this->bottom = -1;
+
+    return;
+}
+
+void Selection::clear()
+{
+    if(this->left > this->right) return;
+
+    /* Only the words inside the bounding rectangle can be non-zero */
+    for(int y = this->top; y <= this->bottom; ++y)
+    {
+        auto first = y*this->wordsPerRow + this->left/64;
+        auto last = y*this->wordsPerRow + this->right/64 + 1;
+        std::fill(this->valid.begin() + first, this->valid.begin() + last, 0);
+        std::fill(this->invalid.begin() + first, this->invalid.begin() + last, 0);
+    }
+
+    this->left = this->top = 0;
+    this->right = this->bottom = -1;
+
+    return;
+}
+
+void Selection::mark(int x, int y, bool isValid)
+{
+    std::uint64_t bit = std::uint64_t(1) << (x%64);
+    unsigned int word = y*this->wordsPerRow + x/64;
+
+    if(isValid)
+    {
+        this->valid[word] |= bit;
+        this->invalid[word] &= ~bit;
+    }
+    else
+    {
+        this->invalid[word] |= bit;
+        this->valid[word] &= ~bit;
+    }
+
+    /* Grow the bounding rectangle */
+    if(this->left > this->right)
+    {
+        this->left = this->right = x;
+        this->top = this->bottom = y;
+    }
+    else
+    {
+        this->left = std::min(this->left, x);
+        this->right = std::max(this->right, x);
+        this->top = std::min(this->top, y);
+        this->bottom = std::max(this->bottom, y);
+    }
+
+    return;
+}
+
+unsigned int Selection::count() const
+{
+    if(this->left > this->right) return 0;
+
+    unsigned int n = 0;
+    for(int y = this->top; y <= this->bottom; ++y)
+    {
+        for(int w = this->left/64; w <= this->right/64; ++w)
+        {
+            n += countBits(this->valid[y*this->wordsPerRow + w]);
+        }
+    }
+
+    return n;
+}
+
+std::size_t Selection::getSize() const
+{
+    return vectorSize(this->valid) + vectorSize(this->invalid);
+}
@@ -0,0 +1,93 @@
+#ifndef SELECTION_HPP
+#define SELECTION_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/* Tiles selected on a map, stored as one bit per tile. The bounding
+ * rectangle of the marked tiles is tracked so that clearing, counting
+ * and iterating only visit the words it covers, rather than the whole
+ * map */
+class Selection
+{
+    private:
+
+    unsigned int width;
+    unsigned int height;
+
+    /* Each row is padded to a whole number of words */
+    unsigned int wordsPerRow;
+
+    /* Tiles that are selected, and tiles inside a selection rectangle
+     * that could not be selected */
+    std::vector<std::uint64_t> valid;
+    std::vector<std::uint64_t> invalid;
+
+    /* Inclusive bounds of every marked tile. Empty if left > right */
+    int left, top, right, bottom;
+
+    public:
+
+    /* Number of set bits in a word, and the index of the lowest. Also
+     * used by other sets of bits */
+    static unsigned int countBits(std::uint64_t word);
+    static unsigned int lowestBit(std::uint64_t word);
+
+    /* Resize the selection to cover a map, deselecting everything */
+    void resize(unsigned int width, unsigned int height);
+
+    /* Deselect every tile */
+    void clear();
+
+    /* Mark a tile as selected or, if isValid is false, as invalid */
+    void mark(int x, int y, bool isValid);
+
+    bool isSelected(int x, int y) const
+    {
+        return (this->valid[y*this->wordsPerRow + x/64] >> (x%64)) & 1;
+    }
+
+    /* True if the tile is either selected or invalid */
+    bool isMarked(int x, int y) const
+    {
+        unsigned int word = y*this->wordsPerRow + x/64;
+        return ((this->valid[word] | this->invalid[word]) >> (x%64)) & 1;
+    }
+
+    /* Number of selected tiles */
+    unsigned int count() const;
+
+    /* Call f with the map index of every selected tile, in map order */
+    template<typename F>
+    void forEachSelected(F f) const
+    {
+        if(this->left > this->right) return;
+
+        for(int y = this->top; y <= this->bottom; ++y)
+        {
+            for(int w = this->left/64; w <= this->right/64; ++w)
+            {
+                std::uint64_t word = this->valid[y*this->wordsPerRow + w];
+                while(word != 0)
+                {
+                    f(y*this->width + w*64 + lowestBit(word));
+                    word &= word - 1;
+                }
+            }
+        }
+
+        return;
+    }
+
+    /* Memory used, in bytes */
+    std::size_t getSize() const;
+
+    /* Constructor */
+    Selection()
+    {
+        this->resize(0, 0);
+    }
+};
+
+#endif /* SELECTION_HPP */
@@ -0,0 +1,44 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+/* Instruction sets the simulation kernels may use. SSE2 is part of
+ * every x86-64 CPU, so is used whenever the compiler targets it. AVX2
+ * is only compiled in where functions can be built for it separately,
+ * and is only used if the CPU supports it. Defining CITYBUILDER_NO_SIMD
+ * leaves just the scalar versions */
+#if !defined(CITYBUILDER_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CITYBUILDER_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(CITYBUILDER_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CITYBUILDER_AVX2
+#define CITYBUILDER_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+#endif
+
+/* True if the CPU can run the AVX2 versions */
+inline bool hasAVX2()
+{
+#ifdef CITYBUILDER_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+/* Name of the widest instruction set in use */
+inline const char* simdInstructionSet()
+{
+#if defined(CITYBUILDER_AVX2)
+    return hasAVX2() ? "AVX2" : "SSE2";
+#elif defined(CITYBUILDER_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+#endif /* SIMD_HPP */
@@ -0,0 +1,271 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include "statistics.hpp"
+#include "city.hpp"
+#include "memory.hpp"
+
+const static char* periodNames[3] = { "day", "month", "year" };
+
+void StatsSeries::push(CityStats&& stats)
+{
+    if(this->samples.size() < this->capacity)
+    {
+        this->samples.push_back(std::move(stats));
+    }
+    else
+    {
+        this->samples[this->first] = std::move(stats);
+        this->first = (this->first + 1) % this->samples.size();
+    }
+
+    return;
+}
+
+void StatsSeries::clear()
+{
+    this->samples.clear();
+    this->first = 0;
+
+    return;
+}
+
+void RegionTotals::rebuild(const Map& map)
+{
+    /* Sum the zones by label, keeping the first zone of each region */
+    std::vector<RegionStats> regions(map.numRegions[int(RegionType::TRANSPORT)], RegionStats(0));
+    for(auto& zone : map.zoneTiles)
+    {
+        for(int pos : zone)
+        {
+            const Tile& tile = map.tiles[pos];
+            RegionStats& region = regions[tile.regions[int(RegionType::TRANSPORT)]];
+            if(region.zones == 0 || pos < region.region) region.region = pos;
+            ++region.zones;
+            if(tile.tileType == TileType::RESIDENTIAL) region.residents += tile.population;
+            else region.workers += tile.population;
+        }
+    }
+
+    std::vector<unsigned int> labels;
+    for(unsigned int label = 0; label < regions.size(); ++label)
+    {
+        if(regions[label].zones > 0) labels.push_back(label);
+    }
+    std::sort(labels.begin(), labels.end(), [&regions](unsigned int a, unsigned int b)
+    {
+        return regions[a].region < regions[b].region;
+    });
+
+    this->regions.clear();
+    this->indices.assign(regions.size(), 0);
+    for(unsigned int label : labels)
+    {
+        this->indices[label] = this->regions.size();
+        this->regions.push_back(regions[label]);
+    }
+
+    return;
+}
+
+std::size_t RegionTotals::getSize() const
+{
+    return vectorSize(this->regions) + vectorSize(this->indices);
+}
+
+/* Add a sample to a running sum, weighted by its number of days */
+static void accumulate(CityStats& total, const CityStats& stats)
+{
+    if(total.days == 0) total.day = stats.day;
+    total.days += stats.days;
+    total.population += stats.population * stats.days;
+    total.employable += stats.employable * stats.days;
+    total.homeless += stats.homeless * stats.days;
+    total.unemployed += stats.unemployed * stats.days;
+    total.funds += stats.funds * stats.days;
+    total.earnings += stats.earnings * stats.days;
+
+    /* Both lists are in order of their first zones, so merge them */
+    std::vector<RegionStats> regions;
+    auto a = total.regions.begin();
+    auto b = stats.regions.begin();
+    while(a != total.regions.end() || b != stats.regions.end())
+    {
+        if(b == stats.regions.end() || (a != total.regions.end() && a->region < b->region))
+        {
+            regions.push_back(*a++);
+            continue;
+        }
+        RegionStats region(b->region);
+        if(a != total.regions.end() && a->region == b->region)
+        {
+            region = *a++;
+        }
+        region.zones += b->zones * stats.days;
+        region.residents += b->residents * stats.days;
+        region.workers += b->workers * stats.days;
+        regions.push_back(region);
+        ++b;
+    }
+    total.regions.swap(regions);
+
+    return;
+}
+
+/* Turn a running sum back into averages */
+static CityStats average(const CityStats& total)
+{
+    CityStats stats = total;
+    double days = total.days;
+    stats.population /= days;
+    stats.employable /= days;
+    stats.homeless /= days;
+    stats.unemployed /= days;
+    stats.funds /= days;
+    stats.earnings /= days;
+    for(auto& region : stats.regions)
+    {
+        region.zones = (region.zones + total.days / 2) / total.days;
+        region.residents /= days;
+        region.workers /= days;
+    }
+
+    return stats;
+}
+
+void StatsRecorder::record(const City& city)
+{
+    CityStats stats;
+    stats.day = city.day;
+    stats.days = 1;
+    stats.population = city.population;
+    stats.employable = city.employable;
+    stats.homeless = city.getHomeless();
+    stats.unemployed = city.getUnemployed();
+    stats.funds = city.funds;
+    stats.earnings = city.earnings;
+
+    stats.regions = city.regionTotals.get();
+
+    accumulate(this->partial[0], stats);
+    this->series[int(StatsPeriod::DAY)].push(std::move(stats));
+
+    if(this->partial[0].days == 30)
+    {
+        CityStats month = average(this->partial[0]);
+        this->partial[0] = CityStats();
+        accumulate(this->partial[1], month);
+        this->series[int(StatsPeriod::MONTH)].push(std::move(month));
+    }
+    if(this->partial[1].days == 360)
+    {
+        CityStats year = average(this->partial[1]);
+        this->partial[1] = CityStats();
+        this->series[int(StatsPeriod::YEAR)].push(std::move(year));
+    }
+
+    return;
+}
+
+void StatsRecorder::clear()
+{
+    for(auto& series : this->series) series.clear();
+    this->partial[0] = CityStats();
+    this->partial[1] = CityStats();
+
+    return;
+}
+
+bool StatsRecorder::exportCSV(const std::string& filename) const
+{
+    std::ofstream outputFile(filename, std::ios::out);
+    if(!outputFile.is_open())
+    {
+        std::cerr << "Error, could not open " << filename << std::endl;
+        return false;
+    }
+
+    /* City rows leave the region columns empty, region rows leave the
+     * city columns empty */
+    outputFile << "period,day,days,population,employable,homeless,unemployed,funds,earnings,"
+        << "region,zones,residents,workers" << std::endl;
+    for(int period = 0; period < 3; ++period)
+    {
+        const StatsSeries& series = this->series[period];
+        for(unsigned int i = 0; i < series.size(); ++i)
+        {
+            const CityStats& stats = series[i];
+            outputFile << periodNames[period] << "," << stats.day << "," << stats.days << ","
+                << stats.population << "," << stats.employable << ","
+                << stats.homeless << "," << stats.unemployed << ","
+                << stats.funds << "," << stats.earnings << ",,,," << std::endl;
+            for(auto& region : stats.regions)
+            {
+                outputFile << periodNames[period] << "," << stats.day << "," << stats.days
+                    << ",,,,,,," << region.region << "," << region.zones << ","
+                    << region.residents << "," << region.workers << std::endl;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool StatsRecorder::exportJSON(const std::string& filename) const
+{
+    std::ofstream outputFile(filename, std::ios::out);
+    if(!outputFile.is_open())
+    {
+        std::cerr << "Error, could not open " << filename << std::endl;
+        return false;
+    }
+
+    outputFile << "{" << std::endl;
+    for(int period = 0; period < 3; ++period)
+    {
+        const StatsSeries& series = this->series[period];
+        outputFile << "  \"" << periodNames[period] << "\": [";
+        for(unsigned int i = 0; i < series.size(); ++i)
+        {
+            const CityStats& stats = series[i];
+            outputFile << (i > 0 ? "," : "") << std::endl
+                << "    { \"day\": " << stats.day << ", \"days\": " << stats.days
+                << ", \"population\": " << stats.population << ", \"employable\": " << stats.employable
+                << ", \"homeless\": " << stats.homeless << ", \"unemployed\": " << stats.unemployed
+                << ", \"funds\": " << stats.funds << ", \"earnings\": " << stats.earnings
+                << ", \"regions\": [";
+            for(unsigned int j = 0; j < stats.regions.size(); ++j)
+            {
+                const RegionStats& region = stats.regions[j];
+                outputFile << (j > 0 ? ", " : "")
+                    << "{ \"region\": " << region.region << ", \"zones\": " << region.zones
+                    << ", \"residents\": " << region.residents << ", \"workers\": " << region.workers << " }";
+            }
+            outputFile << "] }";
+        }
+        outputFile << std::endl << "  ]" << (period < 2 ? "," : "") << std::endl;
+    }
+    outputFile << "}" << std::endl;
+
+    return true;
+}
+
+std::size_t StatsSeries::getSize() const
+{
+    std::size_t size = vectorSize(this->samples);
+    for(auto& sample : this->samples) size += vectorSize(sample.regions);
+
+    return size;
+}
+
+std::size_t StatsRecorder::getSize() const
+{
+    std::size_t size = 0;
+    for(auto& series : this->series) size += series.getSize();
+    for(auto& stats : this->partial) size += vectorSize(stats.regions);
+
+    return size;
+}
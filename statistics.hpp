@@ -0,0 +1,173 @@
+#ifndef STATISTICS_HPP
+#define STATISTICS_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "tile.hpp"
+
+class City;
+class Map;
+
+/* Zones of a single transport region */
+class RegionStats
+{
+    public:
+
+    /* Position of the region's first zone in map order. Labels are
+     * reused and renumbered as regions are updated, but this only
+     * changes when the region itself does */
+    unsigned int region;
+
+    /* Number of zones, and the people living or working in them */
+    unsigned int zones;
+    double residents;
+    double workers;
+
+    RegionStats(unsigned int region)
+    {
+        this->region = region;
+        this->zones = 0;
+        this->residents = 0;
+        this->workers = 0;
+    }
+};
+
+/* Totals of every transport region containing zones. Summed when the
+ * regions change, and otherwise kept up to date as the populations of
+ * their zones change, rather than summed every day */
+class RegionTotals
+{
+    private:
+
+    /* In map order of their first zones */
+    std::vector<RegionStats> regions;
+
+    /* Index into regions of each region label */
+    std::vector<unsigned int> indices;
+
+    public:
+
+    /* Sum every zone of the map */
+    void rebuild(const Map& map);
+
+    /* The population of the zone at pos has changed by delta */
+    void add(const Tile& tile, double delta)
+    {
+        RegionStats& region = this->regions[this->indices[tile.regions[int(RegionType::TRANSPORT)]]];
+        if(tile.tileType == TileType::RESIDENTIAL) region.residents += delta;
+        else region.workers += delta;
+    }
+
+    const std::vector<RegionStats>& get() const { return this->regions; }
+
+    /* Memory used, in bytes */
+    std::size_t getSize() const;
+};
+
+/* The city over a period of one or more days, averaged across them */
+class CityStats
+{
+    public:
+
+    /* First day of the period, and its length */
+    int day;
+    unsigned int days;
+
+    double population;
+    double employable;
+    double homeless;
+    double unemployed;
+    double funds;
+    double earnings;
+
+    /* Regions containing zones, in map order of their first zones */
+    std::vector<RegionStats> regions;
+
+    CityStats()
+    {
+        this->day = 0;
+        this->days = 0;
+        this->population = 0;
+        this->employable = 0;
+        this->homeless = 0;
+        this->unemployed = 0;
+        this->funds = 0;
+        this->earnings = 0;
+    }
+};
+
+/* The most recent samples, up to capacity of them. Older samples are
+ * overwritten */
+class StatsSeries
+{
+    private:
+
+    std::vector<CityStats> samples;
+
+    /* Index of the oldest sample once the series is full */
+    unsigned int first;
+
+    public:
+
+    unsigned int capacity;
+
+    void push(CityStats&& stats);
+
+    unsigned int size() const { return this->samples.size(); }
+
+    /* Samples in order, oldest first */
+    const CityStats& operator[](unsigned int i) const
+    {
+        return this->samples[(this->first + i) % this->samples.size()];
+    }
+
+    void clear();
+
+    /* Memory used, in bytes */
+    std::size_t getSize() const;
+
+    StatsSeries(unsigned int capacity)
+    {
+        this->first = 0;
+        this->capacity = capacity;
+    }
+};
+
+enum class StatsPeriod { DAY, MONTH, YEAR };
+
+/* Records the city every day. Every 30 days are averaged into a month
+ * and every 12 months into a year, and each period keeps a limited
+ * number of samples, so memory stays bounded however long the city
+ * runs */
+class StatsRecorder
+{
+    private:
+
+    /* Sums over the days of the current month and the months of the
+     * current year */
+    CityStats partial[2];
+
+    public:
+
+    /* Indexed by StatsPeriod */
+    StatsSeries series[3];
+
+    void record(const City& city);
+
+    void clear();
+
+    /* Write every sample to a file. Return false if it could not be
+     * opened */
+    bool exportCSV(const std::string& filename) const;
+    bool exportJSON(const std::string& filename) const;
+
+    /* Memory used, in bytes */
+    std::size_t getSize() const;
+
+    /* Two years of days, twenty of months and a thousand of years */
+    StatsRecorder() : series{ StatsSeries(720), StatsSeries(240), StatsSeries(1000) } { }
+};
+
+#endif /* STATISTICS_HPP */
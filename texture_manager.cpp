@@ -1,22 +1,166 @@
 #include <SFML/Graphics.hpp>
 #include <map>
 #include <string>
+#include <vector>
+#include <mutex>
 
 #include "texture_manager.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
 
-void TextureManager::loadTexture(const std::string& name, const std::string& filename)
+TextureHandle TextureManager::registerTexture(const std::string& name, const std::string& filename)
 {
-    /* Load the texture */
-    sf::Texture tex;
-    tex.loadFromFile(filename);
+    auto it = this->handles.find(name);
+    if(it != this->handles.end()) return it->second;
 
-    /* Add it to the list of textures */
-    this->textures[name] = tex;
+    TextureHandle handle = this->textures.size();
+    this->textures.push_back(ManagedTexture(filename));
+    this->handles[name] = handle;
+
+    return handle;
+}
+
+TextureHandle TextureManager::getHandle(const std::string& name)
+{
+    return this->handles.at(name);
+}
+
+void TextureManager::queueTexture(TextureHandle handle)
+{
+    if(this->textures[handle].loaded) return;
+
+    this->queued.push_back(handle);
 
     return;
 }
 
+void TextureManager::decodeQueued(ThreadPool& pool)
+{
+    this->pool = &pool;
+    this->images.resize(this->queued.size());
+    this->numUploaded = 0;
+
+    /* One job per image, so large images do not hold up the rest of the
+     * queue */
+    for(unsigned int i = 0; i < this->queued.size(); ++i)
+    {
+        this->decodeJobs.push_back(pool.submit([this, i](unsigned int)
+        {
+            TraceZone zone("TextureManager::decode");
+            this->images[i].loadFromFile(this->textures[this->queued[i]].filename);
+
+            std::lock_guard<std::mutex> lock(this->decodedMutex);
+            this->decoded.push_back(i);
+        }));
+    }
+
+    return;
+}
+
+unsigned int TextureManager::uploadDecoded()
+{
+    /* A pool without workers only decodes when asked to, so decode an
+     * image here rather than wait forever */
+    if(this->pool != nullptr && this->pool->getNumThreads() == 1) this->pool->runPending();
+
+    std::vector<unsigned int> ready;
+    {
+        std::lock_guard<std::mutex> lock(this->decodedMutex);
+        ready.swap(this->decoded);
+    }
+
+    for(auto i : ready)
+    {
+        this->upload(this->queued[i], this->images[i]);
+
+        /* The pixels now live on the graphics card */
+        this->images[i] = sf::Image();
+        ++this->numUploaded;
+    }
+
+    unsigned int remaining = this->numQueued();
+
+    /* Everything is uploaded so the jobs have all finished */
+    if(remaining == 0)
+    {
+        this->decodeJobs.clear();
+        this->queued.clear();
+        this->images.clear();
+        this->numUploaded = 0;
+    }
+
+    return remaining;
+}
+
+void TextureManager::upload(TextureHandle handle, const sf::Image& image)
+{
+    ManagedTexture& managed = this->textures[handle];
+    if(managed.loaded) return;
+
+    /* A texture that fails to load is still marked as loaded, so that
+     * it is not reloaded every time it is used */
+    managed.texture.loadFromImage(image);
+    managed.loaded = true;
+    managed.lastUsed = this->frame;
+
+    sf::Vector2u size = managed.texture.getSize();
+    this->residentBytes += std::size_t(size.x) * size.y * 4;
+
+    this->evict();
+
+    return;
+}
+
+void TextureManager::evict()
+{
+    if(this->budget == 0) return;
+
+    while(this->residentBytes > this->budget)
+    {
+        ManagedTexture* oldest = nullptr;
+        for(auto& managed : this->textures)
+        {
+            if(!managed.loaded || managed.pinned || managed.lastUsed >= this->frame) continue;
+            if(oldest == nullptr || managed.lastUsed < oldest->lastUsed) oldest = &managed;
+        }
+
+        /* Everything left is in use */
+        if(oldest == nullptr) break;
+
+        sf::Vector2u size = oldest->texture.getSize();
+        this->residentBytes -= std::size_t(size.x) * size.y * 4;
+        oldest->texture = sf::Texture();
+        oldest->loaded = false;
+    }
+
+    return;
+}
+
+sf::Texture& TextureManager::getRef(TextureHandle handle)
+{
+    ManagedTexture& managed = this->textures[handle];
+
+    if(!managed.loaded)
+    {
+        sf::Image image;
+        image.loadFromFile(managed.filename);
+        this->upload(handle, image);
+    }
+    managed.lastUsed = this->frame;
+
+    return managed.texture;
+}
+
 sf::Texture& TextureManager::getRef(const std::string& texture)
 {
-    return this->textures.at(texture);
+    TextureHandle handle = this->getHandle(texture);
+    this->textures[handle].pinned = true;
+
+    return this->getRef(handle);
+}
+
+TextureManager::~TextureManager()
+{
+    /* The jobs write into the images, so they must finish first */
+    for(auto& job : this->decodeJobs) this->pool->wait(job);
 }
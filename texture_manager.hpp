@@ -4,26 +4,136 @@
 #include <SFML/Graphics.hpp>
 #include <string>
 #include <map>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <cstddef>
+
+#include "thread_pool.hpp"
+
+/* Index of a texture registered with a TextureManager. Resolving a
+ * handle is an array lookup, unlike resolving a texture's name */
+typedef unsigned int TextureHandle;
+
+class ManagedTexture
+{
+    public:
+
+    sf::Texture texture;
+
+    /* File the texture is loaded from when first used */
+    std::string filename;
+
+    bool loaded;
+
+    /* Pinned textures are never evicted */
+    bool pinned;
+
+    /* Frame the texture was last used in */
+    unsigned int lastUsed;
+
+    ManagedTexture(const std::string& filename)
+    {
+        this->filename = filename;
+        this->loaded = false;
+        this->pinned = false;
+        this->lastUsed = 0;
+    }
+};
 
 class TextureManager
 {
     private:
 
-    /* Array of textures used */
-    std::map<std::string, sf::Texture> textures;
+    /* Array of textures used. A deque is used so that references to
+     * textures are not invalidated when more are registered */
+    std::deque<ManagedTexture> textures;
+
+    /* Handles of each texture by name */
+    std::map<std::string, TextureHandle> handles;
+
+    /* Handles of textures waiting to be loaded in the background, and
+     * the images decoded from them */
+    std::vector<TextureHandle> queued;
+    std::vector<sf::Image> images;
+
+    /* Pool decoding the queued images, with a job for each image */
+    ThreadPool* pool;
+    std::vector<JobHandle> decodeJobs;
+
+    /* Indices of decoded images that have not yet been uploaded */
+    std::vector<unsigned int> decoded;
+    std::mutex decodedMutex;
+
+    unsigned int numUploaded;
+
+    /* Current frame, used to find textures that have not been used
+     * recently */
+    unsigned int frame;
+
+    /* Bytes of texture memory used by the loaded textures */
+    std::size_t residentBytes;
+
+    /* Turn a decoded image into the handle's texture */
+    void upload(TextureHandle handle, const sf::Image& image);
+
+    /* Unload least recently used textures until the loaded textures
+     * fit in the budget. Textures used this frame are never evicted */
+    void evict();
 
     public:
 
-    /* Add a texture from a file */
-    void loadTexture(const std::string& name, const std::string &filename);
+    /* Maximum bytes of texture memory to keep loaded, or 0 for no limit */
+    std::size_t budget;
+
+    /* Register a texture that will be loaded from the file when it is
+     * first used. Registering a name twice returns the same handle */
+    TextureHandle registerTexture(const std::string& name, const std::string& filename);
+
+    /* Translate a name into a handle */
+    TextureHandle getHandle(const std::string& name);
 
-    /* Translate an id into a reference */
+    /* Add a texture to be loaded in the background by decodeQueued() */
+    void queueTexture(TextureHandle handle);
+
+    /* Start decoding the images of the queued textures on the pool */
+    void decodeQueued(ThreadPool& pool);
+
+    /* Turn every image decoded so far into a texture. Must be called on
+     * the thread that owns the window, since only it can upload textures.
+     * Returns the number of queued textures still to be uploaded */
+    unsigned int uploadDecoded();
+
+    /* Number of queued textures that have not been uploaded yet */
+    unsigned int numQueued() { return this->queued.size() - this->numUploaded; }
+
+    /* Mark the start of a new frame. Textures not used since the last
+     * frame may be evicted to make room for others */
+    void newFrame() { ++this->frame; }
+
+    /* Translate a handle into a reference, loading the texture if
+     * necessary. The reference must be requested again each frame it is
+     * used, since the texture may be evicted when it is not */
+    sf::Texture& getRef(TextureHandle handle);
+
+    /* Translate an id into a reference. The texture is pinned so that
+     * the reference can be kept */
     sf::Texture& getRef(const std::string& texture);
 
+    /* Bytes of texture memory used by the loaded textures */
+    std::size_t getResidentBytes() { return this->residentBytes; }
+
     /* Constructor */
     TextureManager()
     {
+        this->pool = nullptr;
+        this->numUploaded = 0;
+        this->frame = 0;
+        this->residentBytes = 0;
+        this->budget = 0;
     }
+
+    ~TextureManager();
 };
 
 #endif /* TEXTURE_MANAGER_HPP */
@@ -0,0 +1,280 @@
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <algorithm>
+
+#include "thread_pool.hpp"
+
+/* Pool and index of the worker running on this thread, if any */
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local unsigned int currentIndex = 0;
+
+unsigned int ThreadPool::getThreadIndex() const
+{
+    if(currentPool == this) return currentIndex;
+
+    /* Any other thread shares the last queue */
+    return this->workers.size();
+}
+
+void ThreadPool::notify()
+{
+    /* Taking the lock means a thread can't miss the notification
+     * between checking for work and going to sleep */
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+    }
+    this->wake.notify_all();
+
+    return;
+}
+
+void ThreadPool::push(Task&& task)
+{
+    Queue& queue = *this->queues[this->getThreadIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    ++this->pending;
+    this->notify();
+
+    return;
+}
+
+bool ThreadPool::take(unsigned int thread, Task& task)
+{
+    if(this->pending == 0) return false;
+
+    {
+        Queue& queue = *this->queues[thread];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            --this->pending;
+            return true;
+        }
+    }
+
+    for(unsigned int i = 1; i < this->queues.size(); ++i)
+    {
+        Queue& queue = *this->queues[(thread + i) % this->queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            --this->pending;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::workerLoop(unsigned int worker)
+{
+    currentPool = this;
+    currentIndex = worker;
+
+    Task task;
+    while(true)
+    {
+        if(this->take(worker, task))
+        {
+            task(worker);
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->wake.wait(lock, [this]() { return this->stopping || this->pending > 0; });
+        if(this->stopping) return;
+    }
+}
+
+void ThreadPool::helpUntil(const std::function<bool()>& done)
+{
+    unsigned int thread = this->getThreadIndex();
+
+    Task task;
+    while(!done())
+    {
+        if(this->take(thread, task))
+        {
+            task(thread);
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->wake.wait(lock, [&]() { return done() || this->pending > 0; });
+    }
+
+    return;
+}
+
+bool ThreadPool::runPending()
+{
+    unsigned int thread = this->getThreadIndex();
+
+    Task task;
+    if(!this->take(thread, task)) return false;
+    task(thread);
+
+    return true;
+}
+
+void ThreadPool::parallelFor(unsigned int size, unsigned int grain,
+    const std::function<void(unsigned int, unsigned int, unsigned int)>& job)
+{
+    if(size == 0) return;
+    grain = std::max(1u, grain);
+
+    /* Not worth waking anyone for a single range */
+    if(this->workers.empty() || size <= grain)
+    {
+        job(0, size, this->getThreadIndex());
+        return;
+    }
+
+    std::atomic<unsigned int> done(0);
+
+    /* Keep halving the range, leaving the far half for anyone to take,
+     * until it is small enough to run */
+    std::function<void(unsigned int, unsigned int, unsigned int)> split;
+    split = [this, &split, &job, &done, grain, size](unsigned int begin, unsigned int end, unsigned int thread)
+    {
+        while(end - begin > grain)
+        {
+            unsigned int middle = begin + (end - begin) / 2;
+            this->push([&split, middle, end](unsigned int thread) { split(middle, end, thread); });
+            end = middle;
+        }
+        job(begin, end, thread);
+
+        /* The caller may return as soon as the last range is counted,
+         * so nothing captured can be touched afterwards */
+        ThreadPool* pool = this;
+        unsigned int total = size;
+        if(done.fetch_add(end - begin) + (end - begin) == total) pool->notify();
+    };
+
+    split(0, size, this->getThreadIndex());
+    this->helpUntil([&]() { return done == size; });
+
+    return;
+}
+
+void ThreadPool::schedule(const JobHandle& job)
+{
+    this->push([this, job](unsigned int thread)
+    {
+        job->function(thread);
+        this->finish(job);
+    });
+
+    return;
+}
+
+void ThreadPool::finish(const JobHandle& job)
+{
+    std::vector<JobHandle> dependents;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->finished = true;
+        dependents.swap(job->dependents);
+    }
+    for(auto& dependent : dependents)
+    {
+        if(--dependent->waitingOn == 0) this->schedule(dependent);
+    }
+    this->notify();
+
+    return;
+}
+
+JobHandle ThreadPool::submit(const std::function<void(unsigned int)>& function,
+    const std::vector<JobHandle>& dependencies)
+{
+    JobHandle job = std::make_shared<Job>(function);
+
+    for(auto& dependency : dependencies)
+    {
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if(dependency->finished) continue;
+        ++job->waitingOn;
+        dependency->dependents.push_back(job);
+    }
+
+    /* Only start once every dependency has been registered */
+    if(--job->waitingOn == 0) this->schedule(job);
+
+    return job;
+}
+
+void ThreadPool::wait(const JobHandle& job)
+{
+    this->helpUntil([&]() { return job->isFinished(); });
+
+    return;
+}
+
+void ThreadPool::start(unsigned int numThreads)
+{
+    if(numThreads == 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    this->stopping = false;
+    this->pending = 0;
+
+    this->queues.clear();
+    for(unsigned int i = 0; i < numThreads; ++i)
+    {
+        this->queues.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    for(unsigned int i = 0; i + 1 < numThreads; ++i)
+    {
+        this->workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+
+    return;
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+
+    for(auto& worker : this->workers) worker.join();
+    this->workers.clear();
+
+    return;
+}
+
+void ThreadPool::resize(unsigned int numThreads)
+{
+    this->stop();
+    this->start(numThreads);
+
+    return;
+}
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+{
+    this->start(numThreads);
+}
+
+ThreadPool::~ThreadPool()
+{
+    this->stop();
+}
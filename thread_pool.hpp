@@ -0,0 +1,133 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/* A piece of work submitted to a ThreadPool, which may have to wait for
+ * other jobs to finish before it can start */
+class Job
+{
+    private:
+
+    friend class ThreadPool;
+
+    std::function<void(unsigned int)> function;
+
+    /* Unfinished dependencies, plus one until the job is submitted */
+    std::atomic<unsigned int> waitingOn;
+
+    /* Jobs to start once this one finishes */
+    std::vector<std::shared_ptr<Job>> dependents;
+    std::mutex mutex;
+    std::atomic<bool> finished;
+
+    public:
+
+    bool isFinished() const { return this->finished; }
+
+    Job(const std::function<void(unsigned int)>& function) : function(function)
+    {
+        this->waitingOn = 1;
+        this->finished = false;
+    }
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+/* Worker threads that are started once and then reused, so work can be
+ * spread across every core without creating threads. Each thread has
+ * its own queue of tasks. It takes its newest task first, and when it
+ * runs out it steals the oldest task of another thread, which for a
+ * split up range is the largest piece left */
+class ThreadPool
+{
+    private:
+
+    typedef std::function<void(unsigned int)> Task;
+
+    class Queue
+    {
+        public:
+
+        std::deque<Task> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::thread> workers;
+
+    /* One per worker, then one for every other thread */
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    /* Tasks waiting in any queue */
+    std::atomic<unsigned int> pending;
+
+    /* Sleeping threads wait for a task to be pushed or something they
+     * are waiting on to finish */
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    void start(unsigned int numThreads);
+    void stop();
+
+    void workerLoop(unsigned int worker);
+
+    /* Index of the calling thread, below getNumThreads() */
+    unsigned int getThreadIndex() const;
+
+    void push(Task&& task);
+    void notify();
+
+    /* Take a task from the thread's own queue, or steal one */
+    bool take(unsigned int thread, Task& task);
+
+    /* Run tasks on the calling thread until done returns true */
+    void helpUntil(const std::function<bool()>& done);
+
+    void schedule(const JobHandle& job);
+    void finish(const JobHandle& job);
+
+    public:
+
+    /* Threads used by parallelFor, including the calling thread */
+    unsigned int getNumThreads() const { return this->workers.size() + 1; }
+
+    /* Stop the workers and start numThreads threads in total, or one
+     * per core if 0. Nothing may be running on the pool */
+    void resize(unsigned int numThreads);
+
+    /* Call job(begin, end, thread) on ranges covering [0, size), at most
+     * grain long, and wait for them all to finish. thread is below
+     * getNumThreads(), so can index per-thread storage. The calling
+     * thread does its share, and may itself be running on the pool.
+     * Threads outside the pool share an index, so only one of them
+     * should call this at a time */
+    void parallelFor(unsigned int size, unsigned int grain,
+        const std::function<void(unsigned int, unsigned int, unsigned int)>& job);
+
+    /* Run function(thread) once every job in dependencies has finished,
+     * which makes it a continuation of them. If the pool has no workers
+     * jobs only run in wait() and runPending() */
+    JobHandle submit(const std::function<void(unsigned int)>& function,
+        const std::vector<JobHandle>& dependencies = std::vector<JobHandle>());
+
+    /* Wait for a job to finish, running other tasks meanwhile */
+    void wait(const JobHandle& job);
+
+    /* Run a single waiting task on the calling thread, if there is one.
+     * Returns false if there was nothing to run */
+    bool runPending();
+
+    /* Use numThreads threads in total, or one per core if 0 */
+    ThreadPool(unsigned int numThreads = 0);
+    ~ThreadPool();
+};
+
+#endif /* THREAD_POOL_HPP */
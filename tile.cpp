@@ -1,18 +1,14 @@
 #include <SFML/Graphics.hpp>
+#include <string>
 
 #include "animation_handler.hpp"
 #include "tile.hpp"
+#include "texture_manager.hpp"
 
-void Tile::draw(sf::RenderWindow& window, float dt)
+void TilePrototype::draw(sf::RenderWindow& window, const Tile& tile)
 {
     /* Change the sprite to reflect the tile variant */
-    this->animHandler.changeAnim(this->tileVariant);
-
-    /* Update the animation */
-    this->animHandler.update(dt);
-
-    /* Update the sprite */
-    this->sprite.setTextureRect(this->animHandler.bounds);
+    this->sprite.setTextureRect(this->animHandler.getFrame(tile.tileVariant));
 
     /* Draw the tile */
     window.draw(this->sprite);
@@ -20,18 +16,44 @@ void Tile::draw(sf::RenderWindow& window, float dt)
     return;
 }
 
-void Tile::update()
+void Tile::update(const TilePrototype& prototype, std::mt19937& random, float desirability)
 {
     /* If the population is at the maximum value for the tile,
      * there is a small chance that the tile will increase its
-     * building stage */
+     * building stage, scaled by how desirable its location is */
     if((this->tileType == TileType::RESIDENTIAL ||
         this->tileType == TileType::COMMERCIAL ||
         this->tileType == TileType::INDUSTRIAL) &&
-        this->population == this->maxPopPerLevel * (this->tileVariant+1) &&
-        this->tileVariant < this->maxLevels)
+        this->population == prototype.maxPopPerLevel * (this->tileVariant+1) &&
+        this->tileVariant < prototype.maxLevels)
+    {
+        if(random() % int(1e4) < 1e2 / (this->tileVariant+1) * desirability) ++this->tileVariant;
+    }
+
+    return;
+}
+
+void TileAtlas::add(const std::string& name, const TilePrototype& prototype)
+{
+    if(this->prototypes.size() <= int(prototype.tileType))
+        this->prototypes.resize(int(prototype.tileType)+1);
+
+    this->prototypes[int(prototype.tileType)] = prototype;
+    this->names[name] = prototype.tileType;
+
+    return;
+}
+
+void TileAtlas::update(TextureManager& texmgr, float dt)
+{
+    for(auto& prototype : this->prototypes)
     {
-        if(rand() % int(1e4) < 1e2 / (this->tileVariant+1)) ++this->tileVariant;
+        if(prototype.tileType == TileType::VOID) continue;
+
+        /* Resolve the texture every frame, since it may have been
+         * evicted or not yet loaded */
+        prototype.sprite.setTexture(texmgr.getRef(prototype.texture));
+        prototype.animHandler.update(dt);
     }
 
     return;
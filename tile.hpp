@@ -2,20 +2,62 @@
 #define TILE_HPP
 
 #include <SFML/Graphics.hpp>
+#include <string>
 #include <vector>
+#include <map>
+#include <random>
 
 #include "animation_handler.hpp"
+#include "texture_manager.hpp"
 
 enum class TileType { VOID, GRASS, FOREST, WATER, RESIDENTIAL, COMMERCIAL, INDUSTRIAL, ROAD };
 
 std::string tileTypeToStr(TileType type);
 
-class Tile
+/* Set of tile types stored as a bitmask, so testing membership is a
+ * single AND and building a set never allocates. Sets are built by
+ * combining types with |, e.g. TileType::ROAD | TileType::WATER */
+class TileTypeSet
 {
     public:
 
-    AnimationHandler animHandler;
-    sf::Sprite sprite;
+    unsigned int mask;
+
+    constexpr TileTypeSet() : mask(0) { }
+    constexpr TileTypeSet(TileType type) : mask(1u << int(type)) { }
+    constexpr explicit TileTypeSet(unsigned int mask) : mask(mask) { }
+    explicit TileTypeSet(const std::vector<TileType>& types) : mask(0)
+    {
+        for(auto type : types) this->mask |= 1u << int(type);
+    }
+
+    constexpr bool contains(TileType type) const
+    {
+        return (this->mask >> int(type)) & 1u;
+    }
+};
+
+constexpr TileTypeSet operator|(TileTypeSet a, TileTypeSet b)
+{
+    return TileTypeSet(a.mask | b.mask);
+}
+constexpr TileTypeSet operator|(TileType a, TileType b)
+{
+    return TileTypeSet(a) | TileTypeSet(b);
+}
+
+class TilePrototype;
+
+/* Layers of Tile::regions, each connecting a different set of tiles.
+ * Power is supplied across the transport regions */
+enum class RegionType { TRANSPORT, WATER };
+const int numRegionTypes = 2;
+
+/* A single tile of the map. Everything that is the same for every tile
+ * of a type is stored once in the type's TilePrototype instead */
+class Tile
+{
+    public:
 
     TileType tileType;
 
@@ -24,54 +66,89 @@ class Tile
     int tileVariant;
 
     /* Region IDs of the tile, tiles in the same region are connected.
-     * First is for transport */
-    unsigned int regions[1];
+     * Indexed by RegionType */
+    unsigned int regions[numRegionTypes];
+
+    /* Current residents / employees */
+    double population;
+    /* Production output per customer/worker per day, either monetary or goods */
+    float production;
+    /* Goods stored */
+    float storedGoods;
+
+    /* Constructor */
+    Tile(const TileType tileType)
+    {
+        this->tileType = tileType;
+        this->tileVariant = 0;
+        for(auto& region : this->regions) region = 0;
+
+        this->population = 0;
+        this->production = 0;
+        this->storedGoods = 0;
+    }
+    Tile() : Tile(TileType::VOID) { }
+
+    /* Roll for the tile to level up, using the city's random numbers */
+    void update(const TilePrototype& prototype, std::mt19937& random, float desirability = 1.0f);
+};
+
+/* Data shared by every tile of a type */
+class TilePrototype
+{
+    public:
+
+    /* Animations are shared too, so every tile of a type is on the
+     * same frame */
+    AnimationHandler animHandler;
+    sf::Sprite sprite;
+
+    /* Texture of the sprite, resolved when the tiles are drawn */
+    TextureHandle texture;
+
+    TileType tileType;
 
     /* Placement cost of the tile */
     unsigned int cost;
 
-    /* Current residents / employees */
-    double population;
     /* Maximum population per growth stage / tile variant */
     unsigned int maxPopPerLevel;
     /* Maximum number of building levels */
     unsigned int maxLevels;
-    /* Production output per customer/worker per day, either monetary or goods */
-    float production;
-    /* Goods stored */
-    float storedGoods;
 
     /* Constructor */
-    Tile() { }
-    Tile(const unsigned int tileSize, const unsigned int height, sf::Texture& texture,
+    TilePrototype()
+    {
+        this->texture = 0;
+        this->tileType = TileType::VOID;
+        this->cost = 0;
+        this->maxPopPerLevel = 0;
+        this->maxLevels = 0;
+    }
+    TilePrototype(const unsigned int tileSize, const unsigned int height, TextureHandle texture,
         const std::vector<Animation>& animations,
         const TileType tileType, const unsigned int cost, const unsigned int maxPopPerLevel,
         const unsigned int maxLevels)
     {
         this->tileType = tileType;
-        this->tileVariant = 0;
-        this->regions[0] = 0;
 
         this->cost = cost;
-        this->population = 0;
         this->maxPopPerLevel = maxPopPerLevel;
         this->maxLevels = maxLevels;
-        this->production = 0;
-        this->storedGoods = 0;
 
         this->sprite.setOrigin(sf::Vector2f(0.0f, tileSize*(height-1)));
-        this->sprite.setTexture(texture);
+        this->texture = texture;
         this->animHandler.frameSize = sf::IntRect(0, 0, tileSize*2, tileSize*height);
         for(auto animation : animations)
         {
             this->animHandler.addAnim(animation);
         }
-        this->animHandler.update(0.0f);
+        this->animHandler.changeAnim(0);
     }
 
-    void draw(sf::RenderWindow& window, float dt);
-
-    void update();
+    /* Draw a tile of this type. The sprite's position and colour must
+     * already be set */
+    void draw(sf::RenderWindow& window, const Tile& tile);
 
     /* Return a string containing the display cost of the tile */
     std::string getCost()
@@ -80,4 +157,31 @@ class Tile
     }
 };
 
+/* Prototype of every tile type, indexed by type */
+class TileAtlas
+{
+    private:
+
+    std::vector<TilePrototype> prototypes;
+
+    /* Type of each named prototype */
+    std::map<std::string, TileType> names;
+
+    public:
+
+    /* Add a prototype, replacing any existing one of the same type */
+    void add(const std::string& name, const TilePrototype& prototype);
+
+    /* Advance the animations and resolve the textures of every
+     * prototype, ready for drawing */
+    void update(TextureManager& texmgr, float dt);
+
+    TilePrototype& operator[](TileType type) { return this->prototypes[int(type)]; }
+    const TilePrototype& operator[](TileType type) const { return this->prototypes[int(type)]; }
+
+    /* Translate a name into a prototype */
+    TilePrototype& at(const std::string& name) { return this->prototypes[int(this->names.at(name))]; }
+    TilePrototype& operator[](const std::string& name) { return this->at(name); }
+};
+
 #endif /* TILE_HPP */
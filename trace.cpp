@@ -0,0 +1,113 @@
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include "trace.hpp"
+
+Tracer tracer;
+
+/* Small number naming each thread that records an event */
+static std::atomic<unsigned int> numThreads(0);
+static thread_local unsigned int threadIndex = numThreads++;
+
+std::int64_t Tracer::now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::start(std::size_t capacity, double window)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    this->events.assign(std::max<std::size_t>(capacity, 1), TraceEvent());
+    this->next = 0;
+    this->wrapped = false;
+    this->epoch = Tracer::now();
+    this->window = window;
+    this->enabled = true;
+
+    return;
+}
+
+void Tracer::stop()
+{
+    this->enabled = false;
+
+    return;
+}
+
+void Tracer::record(const char* name, std::int64_t start, std::int64_t end)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if(this->events.empty()) return;
+
+    TraceEvent& event = this->events[this->next];
+    event.name = name;
+    event.thread = threadIndex;
+    event.start = start - this->epoch;
+    event.duration = end - start;
+
+    /* Overwrite the oldest events once the buffer is full */
+    if(++this->next == this->events.size())
+    {
+        this->next = 0;
+        this->wrapped = true;
+    }
+
+    return;
+}
+
+Tracer::~Tracer()
+{
+    if(!this->filename.empty()) this->save(this->filename);
+}
+
+bool Tracer::save(const std::string& filename)
+{
+    /* Copy the events out, oldest first, so that the threads being
+     * traced are not held up while the file is written */
+    std::vector<TraceEvent> kept;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if(this->wrapped)
+            kept.insert(kept.end(), this->events.begin() + this->next, this->events.end());
+        kept.insert(kept.end(), this->events.begin(), this->events.begin() + this->next);
+    }
+
+    /* Only keep the events that ended within the window */
+    std::int64_t cutoff = 0;
+    if(this->window > 0.0)
+    {
+        std::int64_t last = 0;
+        for(auto& event : kept) last = std::max(last, event.start + event.duration);
+        cutoff = last - std::int64_t(this->window * 1e6);
+    }
+
+    std::ofstream outputFile(filename, std::ios::out);
+    if(!outputFile.is_open())
+    {
+        std::cerr << "Error, could not write trace to " << filename << std::endl;
+        return false;
+    }
+
+    outputFile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+    outputFile << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"citybuilder\"}}";
+    for(auto& event : kept)
+    {
+        if(event.start + event.duration < cutoff) continue;
+        outputFile << "," << std::endl << "{\"name\":\"" << event.name
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+            << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+    }
+    outputFile << std::endl << "]}" << std::endl;
+
+    outputFile.close();
+
+    return true;
+}
@@ -0,0 +1,147 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "perf_counters.hpp"
+
+/* A zone of code that ran on a thread, in microseconds since the tracer
+ * was started */
+class TraceEvent
+{
+    public:
+
+    /* Must be a string literal, since only the pointer is kept */
+    const char* name;
+
+    unsigned int thread;
+    std::int64_t start;
+    std::int64_t duration;
+};
+
+/* Collects the zones run by every thread and writes them out in the
+ * Chrome trace event format, which chrome://tracing and Perfetto can
+ * open. Events are kept in a ring buffer, so a long run keeps its most
+ * recent events. With a window set the tracer acts as a flight recorder,
+ * only writing out the last few seconds whenever it is asked to */
+class Tracer
+{
+    private:
+
+    std::vector<TraceEvent> events;
+
+    /* Index the next event is written to, and whether the buffer has
+     * been filled at least once */
+    std::size_t next;
+    bool wrapped;
+
+    std::mutex mutex;
+
+    /* Time the tracer was started, in microseconds */
+    std::int64_t epoch;
+
+    public:
+
+    /* Checked before timing a zone, so a stopped tracer costs next to
+     * nothing */
+    std::atomic<bool> enabled;
+
+    /* Seconds of events to write out, or 0 for every event kept */
+    double window;
+
+    /* File the events are written to when the program exits, if any */
+    std::string filename;
+
+    /* Microseconds on a monotonic clock */
+    static std::int64_t now();
+
+    /* Start recording into a buffer of capacity events */
+    void start(std::size_t capacity, double window = 0.0);
+    void stop();
+
+    void record(const char* name, std::int64_t start, std::int64_t end);
+
+    /* Write the kept events to a JSON file. Returns false on failure */
+    bool save(const std::string& filename);
+
+    Tracer()
+    {
+        this->next = 0;
+        this->wrapped = false;
+        this->epoch = 0;
+        this->enabled = false;
+        this->window = 0.0;
+    }
+
+    ~Tracer();
+};
+
+/* Shared by every thread */
+extern Tracer tracer;
+
+/* Times the code from its construction until it is destroyed, or until
+ * next() starts another zone in its place. The hardware counters are
+ * read too while they are enabled */
+class TraceZone
+{
+    private:
+
+    const char* name;
+
+    /* Start time, or -1 if the tracer was not enabled */
+    std::int64_t start;
+
+    /* Counters at the start, if they were enabled */
+    std::uint64_t counts[numCounterTypes];
+    bool counting;
+
+    void begin(const char* name)
+    {
+        this->name = name;
+        this->start = tracer.enabled.load(std::memory_order_relaxed) ? Tracer::now() : -1;
+        this->counting = counters.enabled.load(std::memory_order_relaxed) &&
+            PerfCounters::read(this->counts);
+
+        return;
+    }
+
+    void end()
+    {
+        if(this->start >= 0) tracer.record(this->name, this->start, Tracer::now());
+        if(this->counting)
+        {
+            std::uint64_t counts[numCounterTypes];
+            if(PerfCounters::read(counts)) counters.add(this->name, this->counts, counts);
+        }
+
+        return;
+    }
+
+    public:
+
+    /* End this zone and start timing another */
+    void next(const char* name)
+    {
+        this->end();
+        this->begin(name);
+
+        return;
+    }
+
+    TraceZone(const char* name)
+    {
+        this->begin(name);
+    }
+
+    ~TraceZone()
+    {
+        this->end();
+    }
+};
+
+#endif /* TRACE_HPP */
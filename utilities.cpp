@@ -0,0 +1,104 @@
+#include <vector>
+#include <algorithm>
+
+#include "utilities.hpp"
+#include "map.hpp"
+#include "tile.hpp"
+#include "memory.hpp"
+
+/* Pipes run along the roads, and can also draw from lakes */
+const TileTypeSet UtilityNetworks::waterTiles =
+    TileType::ROAD          | TileType::RESIDENTIAL |
+    TileType::COMMERCIAL    | TileType::INDUSTRIAL  |
+    TileType::WATER;
+
+void UtilityNetworks::invalidate()
+{
+    this->dirty = true;
+
+    return;
+}
+
+void UtilityNetworks::update(const Map& map, std::vector<unsigned int>& changed)
+{
+    const int powerType = int(RegionType::TRANSPORT);
+    const int waterType = int(RegionType::WATER);
+
+    if(this->dirty)
+    {
+        this->powerSupply.assign(map.numRegions[powerType], 0.0f);
+        this->powerDemand.assign(map.numRegions[powerType], 0.0f);
+        this->waterSources.assign(map.numRegions[waterType], 0);
+        this->waterDemand.assign(map.numRegions[waterType], 0.0f);
+        for(auto& tile : map.tiles)
+        {
+            if(tile.tileType == TileType::WATER) ++this->waterSources[tile.regions[waterType]];
+        }
+        for(auto& zone : map.zoneTiles)
+        {
+            for(int pos : zone)
+            {
+                const Tile& tile = map.tiles[pos];
+                if(tile.tileType == TileType::INDUSTRIAL)
+                    this->powerSupply[tile.regions[powerType]] += this->powerPerLevel * (tile.tileVariant+1);
+                this->powerDemand[tile.regions[powerType]] += 1.0f;
+                this->waterDemand[tile.regions[waterType]] += 1.0f;
+            }
+        }
+
+        this->power.resize(this->powerSupply.size());
+        for(unsigned int i = 0; i < this->powerSupply.size(); ++i)
+        {
+            this->power[i] = this->powerDemand[i] > 0 ?
+                std::min(this->powerSupply[i] / this->powerDemand[i], 1.0f) : 1.0f;
+        }
+        this->water.resize(this->waterDemand.size());
+        for(unsigned int i = 0; i < this->waterDemand.size(); ++i)
+        {
+            float supply = float(this->waterSources[i] * this->waterPerTile);
+            this->water[i] = this->waterDemand[i] > 0 ? std::min(supply / this->waterDemand[i], 1.0f) : 1.0f;
+        }
+        this->changedRegions.clear();
+        this->dirty = false;
+
+        return;
+    }
+
+    for(unsigned int i : this->changedRegions)
+    {
+        float power = this->powerDemand[i] > 0 ?
+            std::min(this->powerSupply[i] / this->powerDemand[i], 1.0f) : 1.0f;
+        if(power == this->power[i]) continue;
+        this->power[i] = power;
+        changed.push_back(i);
+    }
+    this->changedRegions.clear();
+
+    return;
+}
+
+void UtilityNetworks::levelUp(const Tile& tile)
+{
+    /* The regions are recounted anyway */
+    if(this->dirty) return;
+
+    unsigned int region = tile.regions[int(RegionType::TRANSPORT)];
+    this->powerSupply[region] += this->powerPerLevel;
+    /* A region that already has enough power stays supplied */
+    if(this->power[region] < 1.0f) this->changedRegions.push_back(region);
+
+    return;
+}
+
+float UtilityNetworks::getSupply(const Tile& tile) const
+{
+    return 0.5f * (this->power[tile.regions[int(RegionType::TRANSPORT)]] +
+        this->water[tile.regions[int(RegionType::WATER)]]);
+}
+
+std::size_t UtilityNetworks::getSize() const
+{
+    return vectorSize(this->powerSupply) + vectorSize(this->powerDemand) + vectorSize(this->waterSources) +
+        vectorSize(this->waterDemand) + vectorSize(this->changedRegions) + vectorSize(this->power) +
+        vectorSize(this->water);
+}
@@ -0,0 +1,76 @@
+#ifndef UTILITIES_HPP
+#define UTILITIES_HPP
+
+#include <vector>
+#include <cstddef>
+
+#include "tile.hpp"
+
+class Map;
+
+/* Power and water supply. The zones in a region share whatever the
+ * region's sources supply. Power lines run along the roads, so each
+ * power network is a transport region, and the power plants are the
+ * industrial zones themselves. Water is pumped from any lake its own
+ * layer of regions reaches */
+class UtilityNetworks
+{
+    private:
+
+    /* Supply and demand in each transport and water region, indexed by
+     * region label. Recounted when the regions have changed, otherwise
+     * only the power supply changes, as industry levels up */
+    std::vector<float> powerSupply;
+    std::vector<float> powerDemand;
+    std::vector<unsigned int> waterSources;
+    std::vector<float> waterDemand;
+    bool dirty;
+
+    /* Transport regions whose power supply has changed since the last
+     * update */
+    std::vector<unsigned int> changedRegions;
+
+    /* Fraction of the demand met in each transport and water region,
+     * indexed by region label */
+    std::vector<float> power;
+    std::vector<float> water;
+
+    public:
+
+    /* Tiles the water network connects */
+    static const TileTypeSet waterTiles;
+
+    /* Zones supplied by each level of an industrial zone, and by each
+     * water tile */
+    unsigned int powerPerLevel;
+    unsigned int waterPerTile;
+
+    /* The water regions have changed */
+    void invalidate();
+
+    /* Recount supply and demand if the regions have changed, or else
+     * rebalance the regions whose supply has. Every zone demands one
+     * unit of each. Adds the transport regions whose fraction of power
+     * changed without a recount to changed */
+    void update(const Map& map, std::vector<unsigned int>& changed);
+
+    /* The industrial zone has gone up a level, adding to its region's
+     * supply from the next update */
+    void levelUp(const Tile& tile);
+
+    /* Fraction of the tile's power and water demand that is met,
+     * averaged. Only valid after update */
+    float getSupply(const Tile& tile) const;
+
+    /* Memory used, in bytes */
+    std::size_t getSize() const;
+
+    UtilityNetworks()
+    {
+        this->dirty = true;
+        this->powerPerLevel = 8;
+        this->waterPerTile = 2;
+    }
+};
+
+#endif /* UTILITIES_HPP */